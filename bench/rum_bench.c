@@ -0,0 +1,1050 @@
+/**************************************************************************************
+ *
+ *  MIT License
+ *
+ *  Copyright (c) 2023 Bagas J. Sitanggang
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ ************************************************************************************/
+#include <rum.h>
+// Only for the -k kernel check, which calls the blit kernels directly
+#include "rum_internal.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+// Micro benchmarks of rum_copy_image and whole frames through a headless context, printed as a table and
+// optionally written as JSON so two commits can be compared:
+//
+//     rum_bench [-o results.json] [-f filter] [-n frames] [-w workers] [-p circles.ppm]
+//
+// `-s threads` runs the concurrent copy stress test, the lock check and the software memory sink check instead
+// and fails when an update was lost,
+// `-k` checks that every blit kernel the CPU can run writes exactly what the scalar one does
+
+#define SCREEN_WIDTH 1280
+#define SCREEN_HEIGHT 720
+// Whole screen copies are also measured at 1080p and 4K, the source image is large enough for the biggest one
+#define MAX_SCREEN_WIDTH 3840
+#define MAX_SCREEN_HEIGHT 2160
+// Copies are repeated in batches of at least this long, so the clock resolution does not matter
+#define MIN_BATCH_TIME 0.001
+#define BATCH_COUNT 11
+#define WARMUP_FRAMES 10
+#define MAX_RESULTS 256
+// Small copies each stress thread makes per frame, on top of a whole pane every few frames
+#define STRESS_COPIES 4
+#define STRESS_MAX_COPY_SIZE 24
+// The kernel check runs every span up to this many pixels, at every offset up to a whole AVX2 register off
+#define CHECK_MAX_SPAN 300
+#define CHECK_MAX_OFFSET 32
+
+typedef struct {
+    char name[64];
+    uint64_t iterations;
+    // Seconds per iteration
+    double median, min;
+    // Pixels that end up on the screen per iteration, 0 when throughput means nothing
+    uint64_t pixels;
+    bool has_frame_stats;
+    RumFrameStats frame_stats;
+} BenchResult;
+
+typedef struct {
+    const char* filter;
+    const char* output;
+    const char* ppm_path;
+    uint32_t frames;
+    uint32_t workers;
+    uint32_t stress_threads;
+    bool check;
+} BenchOptions;
+
+static BenchOptions options = { NULL, NULL, "circles.ppm", 120, 0, 0, false };
+static BenchResult results[MAX_RESULTS];
+static uint32_t result_count;
+static uint8_t* source;
+
+typedef void (*CopyFunc)(RumImageFormat format, const uint8_t* image_data, uint64_t image_width, uint64_t image_height, int32_t x, int32_t y);
+
+typedef struct {
+    const char* name;
+    int32_t width, height;
+} Resolution;
+
+static const Resolution resolutions[] = { { "720p", 1280, 720 }, { "1080p", 1920, 1080 }, { "4k", 3840, 2160 } };
+
+// Screen the copies of the current benchmark land on, what clipped copies are measured against
+static int32_t screen_width = SCREEN_WIDTH, screen_height = SCREEN_HEIGHT;
+
+// The RGBA screen of the per-pixel loop below
+static struct {
+    uint8_t* data;
+    int32_t width, height;
+} legacy_screen;
+
+static double now() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static bool selected(const char* name) {
+    return !options.filter || strstr(name, options.filter);
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static BenchResult* add_result(const char* name, double* samples, uint32_t count, uint64_t iterations, uint64_t pixels) {
+    if(result_count == MAX_RESULTS)
+        return NULL;
+    qsort(samples, count, sizeof(double), compare_double);
+    BenchResult* result = &results[result_count++];
+    memset(result, 0, sizeof(*result));
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    result->iterations = iterations;
+    result->median = samples[count / 2];
+    result->min = samples[0];
+    result->pixels = pixels;
+
+    printf("%-40s %10llu %12.3f %12.3f", result->name, (unsigned long long)iterations, result->median * 1e6, result->min * 1e6);
+    if(pixels)
+        printf(" %12.1f", (double)pixels / result->median * 1e-6);
+    printf("\n");
+    return result;
+}
+
+// Headless context for one group of benchmarks, settings that only apply at init are passed in
+static bool begin_context(RumBackend backend, RumImageFormat format, int32_t width, int32_t height) {
+    screen_width = width;
+    screen_height = height;
+    rum_set_backend(backend);
+    rum_set_screen_format(format);
+    rum_set_worker_count(options.workers);
+    rum_set_vsync(false);
+    return rum_init_headless(width, height);
+}
+
+static void end_context() {
+    rum_terminate();
+    rum_set_async_present(false);
+    rum_set_backend(RUM_BACKEND_OPENGL);
+    rum_set_screen_format(RUM_RGBA);
+}
+
+static const char* format_name(RumImageFormat format) {
+    switch(format) {
+        case RUM_R8: return "r8";
+        case RUM_RG8: return "rg8";
+        case RUM_RGB: return "rgb";
+        case RUM_RGBA: return "rgba";
+        case RUM_BGRA: return "bgra";
+        case RUM_RGB565: return "rgb565";
+        case RUM_RGBA16F: return "rgba16f";
+    }
+    return "unknown";
+}
+
+// Visible part of a copy, what the throughput of a clipped copy is measured against
+static uint64_t visible_pixels(uint64_t width, uint64_t height, int32_t x, int32_t y) {
+    int64_t x0 = x < 0 ? 0 : x, y0 = y < 0 ? 0 : y;
+    int64_t x1 = (int64_t)x + (int64_t)width, y1 = (int64_t)y + (int64_t)height;
+    if(x1 > screen_width) x1 = screen_width;
+    if(y1 > screen_height) y1 = screen_height;
+    return x1 > x0 && y1 > y0 ? (uint64_t)((x1 - x0) * (y1 - y0)) : 0;
+}
+
+// rum_copy_image as it was before the blit kernels, one bounds checked byte at a time into an RGBA screen. The
+// baseline the copy benchmarks are compared against, only RGB and RGBA sources are handled like back then
+static void legacy_copy_image(RumImageFormat format, const uint8_t* image_data, uint64_t image_width, uint64_t image_height, int32_t px, int32_t py) {
+    int channels = format == RUM_RGB ? 3 : 4;
+    for(int dy = 0; dy < (int)image_height; ++dy) {
+        int target_y = py + dy;
+        if(0 <= target_y && target_y < legacy_screen.height) {
+            for(int dx = 0; dx < (int)image_width; ++dx) {
+                int target_x = px + dx;
+                if(0 <= target_x && target_x < legacy_screen.width) {
+                    int source_index = (dy * (int)image_width + dx) * channels;
+                    int target_index = (target_y * legacy_screen.width + target_x) * 4;
+                    for(int i = 0; i < channels; ++i)
+                        legacy_screen.data[target_index + i] = image_data[source_index + i];
+                    if(channels < 4)
+                        legacy_screen.data[target_index + 3] = 255;
+                }
+            }
+        }
+    }
+}
+
+static void bench_copy_with(const char* name, CopyFunc copy, RumImageFormat format, uint64_t width, uint64_t height, int32_t x, int32_t y) {
+    if(!selected(name))
+        return;
+    uint64_t batch = 1;
+    for(;;) {
+        double start = now();
+        for(uint64_t i = 0; i < batch; ++i)
+            copy(format, source, width, height, x, y);
+        if(now() - start >= MIN_BATCH_TIME || batch >= (1u << 20))
+            break;
+        batch *= 2;
+    }
+
+    double samples[BATCH_COUNT];
+    for(uint32_t b = 0; b < BATCH_COUNT; ++b) {
+        double start = now();
+        for(uint64_t i = 0; i < batch; ++i)
+            copy(format, source, width, height, x, y);
+        samples[b] = (now() - start) / (double)batch;
+    }
+    // Nothing is presented here, the staging image is simply overwritten by the next copy
+    add_result(name, samples, BATCH_COUNT, batch * BATCH_COUNT, visible_pixels(width, height, x, y));
+}
+
+static void bench_copy(const char* name, RumImageFormat format, uint64_t width, uint64_t height, int32_t x, int32_t y) {
+    bench_copy_with(name, rum_copy_image, format, width, height, x, y);
+}
+
+// The per-pixel loop next to rum_copy_image, same screen size, formats and placement
+static void run_legacy_copy_benchmarks(const Resolution* resolution) {
+    const RumImageFormat source_formats[] = { RUM_RGB, RUM_RGBA };
+    char name[64];
+    legacy_screen.width = resolution->width;
+    legacy_screen.height = resolution->height;
+    legacy_screen.data = calloc((uint64_t)resolution->width * resolution->height, 4);
+    if(!legacy_screen.data)
+        return;
+    screen_width = resolution->width;
+    screen_height = resolution->height;
+    for(uint32_t f = 0; f < sizeof(source_formats) / sizeof(source_formats[0]); ++f) {
+        snprintf(name, sizeof(name), "copy/legacy/%s_to_rgba/full/%s", format_name(source_formats[f]), resolution->name);
+        bench_copy_with(name, legacy_copy_image, source_formats[f], (uint64_t)resolution->width, (uint64_t)resolution->height, 0, 0);
+    }
+    free(legacy_screen.data);
+    legacy_screen.data = NULL;
+}
+
+static void run_copy_benchmarks() {
+    const RumImageFormat screen_formats[] = { RUM_RGBA, RUM_BGRA, RUM_RGB };
+    const RumImageFormat source_formats[] = { RUM_R8, RUM_RG8, RUM_RGB, RUM_RGBA, RUM_BGRA, RUM_RGB565, RUM_RGBA16F };
+    char name[64];
+
+    for(uint32_t r = 0; r < sizeof(resolutions) / sizeof(resolutions[0]); ++r) {
+        const Resolution* resolution = &resolutions[r];
+        run_legacy_copy_benchmarks(resolution);
+        for(uint32_t s = 0; s < sizeof(screen_formats) / sizeof(screen_formats[0]); ++s) {
+            if(!begin_context(RUM_BACKEND_OPENGL, screen_formats[s], resolution->width, resolution->height))
+                continue;
+            for(uint32_t f = 0; f < sizeof(source_formats) / sizeof(source_formats[0]); ++f) {
+                snprintf(name, sizeof(name), "copy/%s_to_%s/full/%s", format_name(source_formats[f]),
+                        format_name(screen_formats[s]), resolution->name);
+                bench_copy(name, source_formats[f], (uint64_t)resolution->width, (uint64_t)resolution->height, 0, 0);
+            }
+            end_context();
+        }
+    }
+
+    if(!begin_context(RUM_BACKEND_OPENGL, RUM_RGBA, SCREEN_WIDTH, SCREEN_HEIGHT))
+        return;
+    const uint64_t sizes[] = { 16, 64, 256 };
+    for(uint32_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        uint64_t size = sizes[i];
+        snprintf(name, sizeof(name), "copy/rgba/%llux%llu/aligned", (unsigned long long)size, (unsigned long long)size);
+        bench_copy(name, RUM_RGBA, size, size, 64, 64);
+        snprintf(name, sizeof(name), "copy/rgba/%llux%llu/unaligned", (unsigned long long)size, (unsigned long long)size);
+        bench_copy(name, RUM_RGBA, size, size, 67, 65);
+        snprintf(name, sizeof(name), "copy/rgb/%llux%llu/unaligned", (unsigned long long)size, (unsigned long long)size);
+        bench_copy(name, RUM_RGB, size, size, 67, 65);
+    }
+    bench_copy("copy/rgba/256x256/clipped_corner", RUM_RGBA, 256, 256, -128, -128);
+    bench_copy("copy/rgba/256x256/clipped_edge", RUM_RGBA, 256, 256, SCREEN_WIDTH - 64, 100);
+    bench_copy("copy/rgba/256x256/offscreen", RUM_RGBA, 256, 256, SCREEN_WIDTH + 16, 0);
+    bench_copy("copy/rgba/oversized", RUM_RGBA, SCREEN_WIDTH + 64, SCREEN_HEIGHT + 64, -32, -32);
+
+    // The same frame over and over, every tile compares equal after the first copy
+    rum_set_change_detection(true);
+    bench_copy("copy/rgba/full/change_detection", RUM_RGBA, SCREEN_WIDTH, SCREEN_HEIGHT, 0, 0);
+    rum_set_change_detection(false);
+    end_context();
+}
+
+typedef void (*FrameFunc)(void* user, uint32_t frame);
+
+// Times whole frames, the work done by `func` plus rum_update_screen, and keeps rum's own breakdown of them
+static void bench_frames(const char* name, FrameFunc func, void* user, uint64_t pixels) {
+    double* samples = malloc(options.frames * sizeof(double));
+    if(!samples)
+        return;
+    for(uint32_t i = 0; i < WARMUP_FRAMES; ++i) {
+        func(user, i);
+        rum_update_screen();
+    }
+    rum_set_frame_stats_window(options.frames);
+    for(uint32_t i = 0; i < options.frames; ++i) {
+        double start = now();
+        func(user, WARMUP_FRAMES + i);
+        rum_update_screen();
+        samples[i] = now() - start;
+    }
+    BenchResult* result = add_result(name, samples, options.frames, options.frames, pixels);
+    if(result)
+        result->has_frame_stats = rum_get_frame_stats(&result->frame_stats);
+    rum_set_frame_stats_window(0);
+    free(samples);
+}
+
+typedef struct {
+    RumImageFormat format;
+    uint64_t width, height;
+    const uint8_t* pixels;
+    int32_t x, y;
+    RumImage* image;
+    uint32_t count;
+    RumWindow** windows;
+} FrameWork;
+
+static void copy_frame(void* user, uint32_t frame) {
+    FrameWork* work = user;
+    (void)frame;
+    rum_copy_image(work->format, work->pixels, work->width, work->height, work->x, work->y);
+}
+
+// A small rect moving over the screen, what a cursor or a blinking widget looks like
+static void moving_rect_frame(void* user, uint32_t frame) {
+    FrameWork* work = user;
+    int32_t x = (int32_t)((frame * 37) % (SCREEN_WIDTH - work->width));
+    int32_t y = (int32_t)((frame * 23) % (SCREEN_HEIGHT - work->height));
+    rum_copy_image(work->format, work->pixels, work->width, work->height, x, y);
+}
+
+// Goes through the mailbox from the main thread, which shows what the handoff itself costs
+static void submit_frame(void* user, uint32_t frame) {
+    FrameWork* work = user;
+    (void)frame;
+    rum_submit_frame(work->pixels);
+}
+
+static void lock_frame(void* user, uint32_t frame) {
+    (void)user;
+    uint8_t* pixels;
+    uint64_t pitch;
+    if(!rum_lock_framebuffer(&pixels, &pitch))
+        return;
+    for(uint64_t y = 0; y < SCREEN_HEIGHT; ++y)
+        memset(pixels + y * pitch, (int)((frame + y) & 0xff), pitch);
+    rum_unlock_framebuffer();
+}
+
+static void sprite_frame(void* user, uint32_t frame) {
+    FrameWork* work = user;
+    for(uint32_t i = 0; i < work->count; ++i) {
+        int32_t x = (int32_t)((i * 97 + frame) % SCREEN_WIDTH);
+        int32_t y = (int32_t)((i * 57) % SCREEN_HEIGHT);
+        RumRect source = { (int64_t)(i % 16) * 16, (int64_t)(i / 16 % 16) * 16, 16, 16 };
+        rum_draw_sprite(work->image, x, y, &source, 1.0f);
+    }
+}
+
+static void image_frame(void* user, uint32_t frame) {
+    FrameWork* work = user;
+    (void)frame;
+    rum_draw_image(work->image, work->x, work->y);
+}
+
+// Every extra window gets a whole new frame, then bench_frames updates the default one and waits for vsync once
+static void windows_frame(void* user, uint32_t frame) {
+    FrameWork* work = user;
+    (void)frame;
+    for(uint32_t i = 0; i < work->count; ++i) {
+        rum_window_copy_image(work->windows[i], work->format, work->pixels, work->width, work->height, 0, 0);
+        rum_window_update(work->windows[i]);
+    }
+}
+
+static void idle_frame(void* user, uint32_t frame) {
+    (void)user; (void)frame;
+}
+
+static void run_frame_benchmarks() {
+    const uint64_t screen_pixels = (uint64_t)SCREEN_WIDTH * SCREEN_HEIGHT;
+    // The async variant times what the main thread spends per frame, the present thread draws in the background
+    const RumBackend backends[] = { RUM_BACKEND_OPENGL, RUM_BACKEND_OPENGL, RUM_BACKEND_SOFTWARE };
+    const bool async[] = { false, true, false };
+    const char* backend_names[] = { "opengl", "opengl_async", "software" };
+    char name[64];
+
+    for(uint32_t b = 0; b < 3; ++b) {
+        rum_set_async_present(async[b]);
+        if(!begin_context(backends[b], RUM_RGBA, SCREEN_WIDTH, SCREEN_HEIGHT))
+            continue;
+        FrameWork work = { RUM_RGBA, SCREEN_WIDTH, SCREEN_HEIGHT, source, 0, 0, NULL, 0, NULL };
+        snprintf(name, sizeof(name), "frame/%s/copy_full_rgba", backend_names[b]);
+        if(selected(name))
+            bench_frames(name, copy_frame, &work, screen_pixels);
+
+        work.format = RUM_RGB;
+        snprintf(name, sizeof(name), "frame/%s/copy_full_rgb", backend_names[b]);
+        if(selected(name))
+            bench_frames(name, copy_frame, &work, screen_pixels);
+
+        work.format = RUM_RGBA;
+        work.width = work.height = 64;
+        snprintf(name, sizeof(name), "frame/%s/copy_moving_64x64", backend_names[b]);
+        if(selected(name))
+            bench_frames(name, moving_rect_frame, &work, 64 * 64);
+
+        work.width = SCREEN_WIDTH;
+        work.height = SCREEN_HEIGHT;
+        snprintf(name, sizeof(name), "frame/%s/submit_full", backend_names[b]);
+        if(selected(name))
+            bench_frames(name, submit_frame, &work, screen_pixels);
+
+        // copy_full_rgba again with the CPU held back until the GPU has finished the previous frame
+        snprintf(name, sizeof(name), "frame/%s/copy_full_in_flight_1", backend_names[b]);
+        if(backends[b] == RUM_BACKEND_OPENGL && selected(name)) {
+            rum_set_max_frames_in_flight(1);
+            bench_frames(name, copy_frame, &work, screen_pixels);
+            rum_set_max_frames_in_flight(0);
+        }
+
+        snprintf(name, sizeof(name), "frame/%s/lock_full", backend_names[b]);
+        if(selected(name))
+            bench_frames(name, lock_frame, NULL, screen_pixels);
+
+        snprintf(name, sizeof(name), "frame/%s/idle_on_change", backend_names[b]);
+        if(selected(name)) {
+            rum_set_present_mode(RUM_PRESENT_ON_CHANGE);
+            bench_frames(name, idle_frame, NULL, 0);
+            rum_set_present_mode(RUM_PRESENT_ALWAYS);
+        }
+        end_context();
+    }
+
+    // Sprites of all 256 cells of one atlas, up to the count where queueing them dominates the frame
+    const uint32_t sprite_counts[] = { 10000, 100000, 1000000 };
+    const char* sprite_names[] = { "frame/opengl/sprites_10k", "frame/opengl/sprites_100k", "frame/opengl/sprites_1m" };
+    bool sprites_selected = false;
+    for(uint32_t c = 0; c < 3; ++c)
+        sprites_selected = sprites_selected || selected(sprite_names[c]);
+    if(sprites_selected && begin_context(RUM_BACKEND_OPENGL, RUM_RGBA, SCREEN_WIDTH, SCREEN_HEIGHT)) {
+        FrameWork work = { 0 };
+        work.image = rum_create_image(RUM_RGBA, source, 256, 256);
+        for(uint32_t c = 0; work.image && c < 3; ++c) {
+            work.count = sprite_counts[c];
+            if(selected(sprite_names[c]))
+                bench_frames(sprite_names[c], sprite_frame, &work, 0);
+        }
+        if(work.image)
+            rum_destroy_image(work.image);
+        end_context();
+    }
+
+    if(selected("frame/opengl/windows_4") && begin_context(RUM_BACKEND_OPENGL, RUM_RGBA, SCREEN_WIDTH, SCREEN_HEIGHT)) {
+        RumWindow* windows[4];
+        FrameWork work = { RUM_RGBA, SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, source, 0, 0, NULL, 0, windows };
+        while(work.count < 4 && (windows[work.count] = rum_window_create("rum_bench", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2)))
+            ++work.count;
+        if(work.count == 4)
+            bench_frames("frame/opengl/windows_4", windows_frame, &work, 4 * work.width * work.height);
+        for(uint32_t i = 0; i < work.count; ++i)
+            rum_window_destroy(windows[i]);
+        end_context();
+    }
+}
+
+// Binary PPM as written by most tools, a maxval of 255 and at most one comment per header line
+static uint8_t* load_ppm(const char* path, uint64_t* width, uint64_t* height) {
+    FILE* file = fopen(path, "rb");
+    if(!file)
+        return NULL;
+    unsigned int w = 0, h = 0, maxval = 0;
+    char magic[3] = { 0 };
+    if(fscanf(file, "%2s", magic) != 1 || strcmp(magic, "P6") != 0) {
+        fclose(file);
+        return NULL;
+    }
+    unsigned int* fields[] = { &w, &h, &maxval };
+    for(int i = 0; i < 3; ++i) {
+        int c;
+        while((c = fgetc(file)) == '#' || c == ' ' || c == '\t' || c == '\n' || c == '\r')
+            if(c == '#')
+                while((c = fgetc(file)) != '\n' && c != EOF)
+                    ;
+        ungetc(c, file);
+        if(fscanf(file, "%u", fields[i]) != 1) {
+            fclose(file);
+            return NULL;
+        }
+    }
+    fgetc(file);
+    if(maxval != 255 || w == 0 || h == 0) {
+        fclose(file);
+        return NULL;
+    }
+
+    // Expanded to RGBA like stbi_load(..., 4) in the README example
+    uint64_t count = (uint64_t)w * h;
+    uint8_t* pixels = malloc(count * 4);
+    if(pixels && fread(pixels, 3, count, file) == count) {
+        for(uint64_t i = count; i-- > 0;) {
+            pixels[i * 4 + 3] = 255;
+            pixels[i * 4 + 2] = pixels[i * 3 + 2];
+            pixels[i * 4 + 1] = pixels[i * 3 + 1];
+            pixels[i * 4 + 0] = pixels[i * 3 + 0];
+        }
+    } else {
+        free(pixels);
+        pixels = NULL;
+    }
+    fclose(file);
+    *width = w;
+    *height = h;
+    return pixels;
+}
+
+// The README example on a 640x480 screen: circles.ppm drawn at (100, 0) every frame, which clips it on two
+// sides. Once the way the README used to do it, copying the pixels each frame, and once as a retained image
+static void run_readme_benchmarks() {
+    if(!selected("readme/"))
+        return;
+    uint64_t width, height;
+    uint8_t* circles = load_ppm(options.ppm_path, &width, &height);
+    if(!circles) {
+        fprintf(stderr, "rum_bench: could not load %s, skipping the readme workloads\n", options.ppm_path);
+        return;
+    }
+    if(begin_context(RUM_BACKEND_OPENGL, RUM_RGBA, 640, 480)) {
+        FrameWork work = { RUM_RGBA, width, height, circles, 100, 0, NULL, 0, NULL };
+        if(selected("readme/circles_copy"))
+            bench_frames("readme/circles_copy", copy_frame, &work, 540 * 480);
+        work.image = rum_create_image(RUM_RGBA, circles, width, height);
+        if(work.image && selected("readme/circles_image"))
+            bench_frames("readme/circles_image", image_frame, &work, 540 * 480);
+        rum_destroy_image(work.image);
+        end_context();
+    }
+    free(circles);
+}
+
+// Startup cost of each backend, the software one never loads GL
+static void run_init_benchmarks() {
+    const RumBackend backends[] = { RUM_BACKEND_OPENGL, RUM_BACKEND_SOFTWARE };
+    const char* names[] = { "init/opengl", "init/software" };
+    for(uint32_t b = 0; b < 2; ++b) {
+        if(!selected(names[b]))
+            continue;
+        double samples[5];
+        uint32_t count = 0;
+        for(uint32_t i = 0; i < 5; ++i) {
+            double start = now();
+            bool ok = begin_context(backends[b], RUM_RGBA, SCREEN_WIDTH, SCREEN_HEIGHT);
+            double elapsed = now() - start;
+            if(!ok)
+                break;
+            end_context();
+            samples[count++] = elapsed;
+        }
+        if(count > 0)
+            add_result(names[b], samples, count, count, 0);
+    }
+}
+
+// One vertical pane of the screen per stress thread. Pane edges are odd, so neighbours share dirty cells
+// and tiles, and every copy is mirrored into the reference the readback is compared against
+typedef struct {
+    int32_t x0, x1;
+    uint32_t frame;
+    uint32_t seed;
+    uint64_t copies;
+    uint8_t* reference;
+    uint8_t* pane;
+    uint8_t block[STRESS_MAX_COPY_SIZE * STRESS_MAX_COPY_SIZE * 4];
+} StressPane;
+
+static uint32_t next_random(uint32_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void fill_color(uint8_t* pixels, uint64_t count, uint32_t color) {
+    for(uint64_t i = 0; i < count; ++i) {
+        pixels[i * 4 + 0] = (uint8_t)color;
+        pixels[i * 4 + 1] = (uint8_t)(color >> 8);
+        pixels[i * 4 + 2] = (uint8_t)(color >> 16);
+        pixels[i * 4 + 3] = 0xff;
+    }
+}
+
+// Copies one RGBA image the way rum_copy_image does, clipped to the screen
+static void copy_reference(uint8_t* reference, const uint8_t* pixels, int32_t width, int32_t height, int32_t x, int32_t y) {
+    for(int32_t row = 0; row < height; ++row) {
+        if(y + row < 0 || y + row >= SCREEN_HEIGHT)
+            continue;
+        for(int32_t column = 0; column < width; ++column) {
+            if(x + column < 0 || x + column >= SCREEN_WIDTH)
+                continue;
+            memcpy(reference + ((uint64_t)(y + row) * SCREEN_WIDTH + x + column) * 4, pixels + ((uint64_t)row * width + column) * 4, 4);
+        }
+    }
+}
+
+static void stress_pane(StressPane* pane) {
+    int32_t pane_width = pane->x1 - pane->x0;
+    // A whole pane at once is large enough to be spread over the workers
+    if(pane->frame % 8 == 0) {
+        fill_color(pane->pane, (uint64_t)pane_width * SCREEN_HEIGHT, next_random(&pane->seed));
+        rum_copy_image(RUM_RGBA, pane->pane, pane_width, SCREEN_HEIGHT, pane->x0, 0);
+        copy_reference(pane->reference, pane->pane, pane_width, SCREEN_HEIGHT, pane->x0, 0);
+        pane->copies++;
+    }
+    for(uint32_t i = 0; i < STRESS_COPIES; ++i) {
+        int32_t width = 1 + (int32_t)(next_random(&pane->seed) % STRESS_MAX_COPY_SIZE);
+        int32_t height = 1 + (int32_t)(next_random(&pane->seed) % STRESS_MAX_COPY_SIZE);
+        if(width > pane_width)
+            width = pane_width;
+        int32_t x = pane->x0 + (int32_t)(next_random(&pane->seed) % (uint32_t)(pane_width - width + 1));
+        // Some of them hang over the top or bottom edge of the screen
+        int32_t y = (int32_t)(next_random(&pane->seed) % (SCREEN_HEIGHT + 16)) - 8 - height / 2;
+        fill_color(pane->block, (uint64_t)width * height, next_random(&pane->seed));
+        rum_copy_image(RUM_RGBA, pane->block, width, height, x, y);
+        copy_reference(pane->reference, pane->block, width, height, x, y);
+        pane->copies++;
+    }
+}
+
+#ifdef _WIN32
+typedef HANDLE StressThread;
+
+static DWORD WINAPI stress_thread_main(LPVOID user) {
+    stress_pane(user);
+    return 0;
+}
+
+static bool start_stress_thread(StressThread* thread, StressPane* pane) {
+    *thread = CreateThread(NULL, 0, stress_thread_main, pane, 0, NULL);
+    return *thread != NULL;
+}
+
+static void join_stress_thread(StressThread thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+#else
+typedef pthread_t StressThread;
+
+static void* stress_thread_main(void* user) {
+    stress_pane(user);
+    return NULL;
+}
+
+static bool start_stress_thread(StressThread* thread, StressPane* pane) {
+    return pthread_create(thread, NULL, stress_thread_main, pane) == 0;
+}
+
+static void join_stress_thread(StressThread thread) {
+    pthread_join(thread, NULL);
+}
+#endif
+
+// Every frame each thread copies into its own pane while the others do the same, then the main thread
+// presents and reads the screen back. Any pixel that differs from the reference is an update that was lost
+static bool run_stress(RumBackend backend, const char* name, uint32_t thread_count) {
+    uint64_t screen_size = (uint64_t)SCREEN_WIDTH * SCREEN_HEIGHT * 4;
+    uint8_t* reference = calloc(1, screen_size);
+    uint8_t* screen = malloc(screen_size);
+    StressPane* panes = calloc(thread_count, sizeof(StressPane));
+    StressThread* threads = calloc(thread_count, sizeof(StressThread));
+    bool ok = reference && screen && panes && threads && begin_context(backend, RUM_RGBA, SCREEN_WIDTH, SCREEN_HEIGHT);
+    uint64_t copies = 0, lost = 0;
+    uint32_t frame = 0;
+
+    for(uint32_t i = 0; ok && i < thread_count; ++i) {
+        panes[i].x0 = i == 0 ? 0 : (int32_t)(i * SCREEN_WIDTH / thread_count) | 1;
+        panes[i].x1 = i + 1 == thread_count ? SCREEN_WIDTH : (int32_t)((i + 1) * SCREEN_WIDTH / thread_count) | 1;
+        panes[i].seed = 0x9e3779b9u * (i + 1);
+        panes[i].reference = reference;
+        panes[i].pane = malloc((uint64_t)(panes[i].x1 - panes[i].x0) * SCREEN_HEIGHT * 4);
+        ok = panes[i].pane != NULL;
+    }
+    if(ok) {
+        // The texture starts out undefined, the reference starts out black
+        rum_copy_image(RUM_RGBA, reference, SCREEN_WIDTH, SCREEN_HEIGHT, 0, 0);
+    }
+
+    for(; ok && frame < options.frames; ++frame) {
+        // Half of the frames go through the change detection path, which marks tiles from inside the workers
+        rum_set_change_detection(frame / 4 % 2 == 1);
+        uint32_t started = 0;
+        for(; started < thread_count; ++started) {
+            panes[started].frame = frame;
+            if(!start_stress_thread(&threads[started], &panes[started]))
+                break;
+        }
+        for(uint32_t i = 0; i < started; ++i)
+            join_stress_thread(threads[i]);
+        if(started < thread_count || (rum_update_screen(), !rum_read_screen(screen))) {
+            ok = false;
+            break;
+        }
+
+        uint64_t frame_lost = 0;
+        for(uint64_t i = 0; i < screen_size; i += 4)
+            frame_lost += memcmp(screen + i, reference + i, 4) != 0;
+        if(frame_lost > 0 && lost == 0) {
+            uint64_t first = 0;
+            while(memcmp(screen + first * 4, reference + first * 4, 4) == 0)
+                ++first;
+            fprintf(stderr, "%s: frame %u first differs at (%llu, %llu)\n", name, frame,
+                    (unsigned long long)(first % SCREEN_WIDTH), (unsigned long long)(first / SCREEN_WIDTH));
+        }
+        lost += frame_lost;
+    }
+    rum_set_change_detection(false);
+    if(reference && screen && panes && threads)
+        end_context();
+
+    for(uint32_t i = 0; panes && i < thread_count; ++i) {
+        copies += panes[i].copies;
+        free(panes[i].pane);
+    }
+    printf("%-40s %u threads, %u frames, %llu copies, %llu pixels lost\n", name, thread_count, frame,
+           (unsigned long long)copies, (unsigned long long)lost);
+    free(threads);
+    free(panes);
+    free(screen);
+    free(reference);
+    return ok && lost == 0;
+}
+
+// Draws a whole frame through rum_lock_framebuffer, presents it, then copies a small block over it. Everything
+// outside the block has to still show the locked frame after the next present
+static bool run_lock_check(RumBackend backend, const char* name) {
+    uint64_t screen_size = (uint64_t)SCREEN_WIDTH * SCREEN_HEIGHT * 4;
+    uint8_t* screen = malloc(screen_size);
+    uint8_t block[16 * 16 * 4];
+    uint8_t* pixels;
+    uint64_t pitch;
+    bool ok = screen && begin_context(backend, RUM_RGBA, SCREEN_WIDTH, SCREEN_HEIGHT);
+    uint64_t lost = 0;
+    if(ok && rum_lock_framebuffer(&pixels, &pitch)) {
+        for(uint64_t y = 0; y < SCREEN_HEIGHT; ++y)
+            fill_color(pixels + y * pitch, SCREEN_WIDTH, 0x204060u + (uint32_t)y);
+        rum_unlock_framebuffer();
+        rum_update_screen();
+        fill_color(block, 16 * 16, 0xc0ffeeu);
+        rum_copy_image(RUM_RGBA, block, 16, 16, 100, 100);
+        rum_update_screen();
+        ok = rum_read_screen(screen);
+        for(uint64_t y = 0; ok && y < SCREEN_HEIGHT; ++y) {
+            for(uint64_t x = 0; x < SCREEN_WIDTH; ++x) {
+                bool inside = x >= 100 && x < 116 && y >= 100 && y < 116;
+                uint8_t expected[4];
+                fill_color(expected, 1, inside ? 0xc0ffeeu : 0x204060u + (uint32_t)y);
+                lost += memcmp(screen + (y * SCREEN_WIDTH + x) * 4, expected, 4) != 0;
+            }
+        }
+    } else {
+        ok = false;
+    }
+    if(screen)
+        end_context();
+    printf("%-40s %llu pixels lost\n", name, (unsigned long long)lost);
+    free(screen);
+    return ok && lost == 0;
+}
+
+// A full copy and then a few small copies per frame, which only present their dirty rects, read back at the end
+static bool present_sink_frames(RumBackend backend, RumImageFormat format, uint8_t* screen) {
+    uint8_t* row = malloc((uint64_t)SCREEN_WIDTH * 4);
+    uint8_t block[STRESS_MAX_COPY_SIZE * STRESS_MAX_COPY_SIZE * 4];
+    uint32_t seed = 0x2545f491u;
+    bool ok = row && begin_context(backend, format, SCREEN_WIDTH, SCREEN_HEIGHT);
+    for(int32_t y = 0; ok && y < SCREEN_HEIGHT; ++y) {
+        fill_color(row, SCREEN_WIDTH, 0x3070b0u + (uint32_t)y * 0x010203u);
+        rum_copy_image(RUM_RGBA, row, SCREEN_WIDTH, 1, 0, y);
+    }
+    for(uint32_t frame = 0; ok && frame < options.frames; ++frame) {
+        rum_update_screen();
+        for(uint32_t i = 0; i < STRESS_COPIES; ++i) {
+            int32_t width = 1 + (int32_t)(next_random(&seed) % STRESS_MAX_COPY_SIZE);
+            int32_t height = 1 + (int32_t)(next_random(&seed) % STRESS_MAX_COPY_SIZE);
+            int32_t x = (int32_t)(next_random(&seed) % (SCREEN_WIDTH + 16)) - 8 - width / 2;
+            int32_t y = (int32_t)(next_random(&seed) % (SCREEN_HEIGHT + 16)) - 8 - height / 2;
+            fill_color(block, (uint64_t)width * height, next_random(&seed));
+            rum_copy_image(RUM_RGBA, block, width, height, x, y);
+        }
+    }
+    if(ok) {
+        rum_update_screen();
+        ok = rum_read_screen(screen);
+        end_context();
+    }
+    free(row);
+    return ok;
+}
+
+// The software backend converts the screen image itself, so the same frames go through the OpenGL backend and
+// the software one's memory sink and have to read back the same. The shader and the CPU may round RGB565 and
+// half floats differently, one step per channel is allowed
+static bool run_sink_check(RumImageFormat format, const char* name) {
+    uint64_t screen_size = (uint64_t)SCREEN_WIDTH * SCREEN_HEIGHT * 4;
+    uint8_t* expected = malloc(screen_size);
+    uint8_t* screen = malloc(screen_size);
+    bool ok = expected && screen && present_sink_frames(RUM_BACKEND_OPENGL, format, expected)
+            && present_sink_frames(RUM_BACKEND_SOFTWARE, format, screen);
+    uint64_t lost = 0;
+    for(uint64_t i = 0; ok && i < screen_size; i += 4) {
+        bool same = true;
+        for(uint64_t c = 0; c < 4; ++c)
+            same = same && abs((int)screen[i + c] - (int)expected[i + c]) <= 1;
+        lost += !same;
+    }
+    printf("%-40s %llu pixels lost\n", name, (unsigned long long)lost);
+    free(screen);
+    free(expected);
+    return ok && lost == 0;
+}
+
+typedef struct {
+    const char* name;
+    RumRowKernel kernel, reference;
+} CheckedKernel;
+
+// Runs the kernel and the reference on the same span, both starting `dst_offset` bytes into a buffer of guard
+// bytes, and compares the whole buffers so writes past the span count too
+static bool check_span(const CheckedKernel* checked, const uint8_t* src, uint64_t count, uint32_t dst_offset,
+        uint8_t* dst, uint8_t* expected, uint64_t buffer_size) {
+    memset(dst, 0xCD, buffer_size);
+    memset(expected, 0xCD, buffer_size);
+    checked->kernel(dst + dst_offset, src, count);
+    checked->reference(expected + dst_offset, src, count);
+    return memcmp(dst, expected, buffer_size) == 0;
+}
+
+// Converts pixel by pixel as well as in one call, the one call goes through _rum_convert_row's 256 pixel chunks
+static bool check_convert_span(RumImageFormat dst_format, RumImageFormat src_format, const uint8_t* src, uint64_t count,
+        uint32_t dst_offset, uint8_t* dst, uint8_t* expected, uint64_t buffer_size) {
+    uint32_t src_size = _rum_get_format_size(src_format), dst_size = _rum_get_format_size(dst_format);
+    memset(dst, 0xCD, buffer_size);
+    memset(expected, 0xCD, buffer_size);
+    _rum_convert_row(dst + dst_offset, dst_format, src, src_format, count);
+    for(uint64_t i = 0; i < count; ++i)
+        _rum_convert_row(expected + dst_offset + i * dst_size, dst_format, src + i * src_size, src_format, 1);
+    return memcmp(dst, expected, buffer_size) == 0;
+}
+
+static bool run_kernel_check() {
+    uint64_t buffer_size = (uint64_t)(CHECK_MAX_SPAN + CHECK_MAX_OFFSET) * 8 + 64;
+    uint8_t* src = malloc(buffer_size);
+    uint8_t* halves = malloc(buffer_size);
+    uint8_t* dst = malloc(buffer_size);
+    uint8_t* expected = malloc(buffer_size);
+    bool ok = src && halves && dst && expected;
+    uint32_t state = 1;
+    for(uint64_t i = 0; ok && i < buffer_size; i += 2) {
+        state = state * 1664525u + 1013904223u;
+        src[i] = (uint8_t)(state >> 24);
+        src[i + 1] = (uint8_t)(state >> 16);
+        // Half floats between 0.5 and 1, the range rum keeps them in
+        uint16_t half = (uint16_t)(0x3800 + (state >> 8 & 0x3ff));
+        memcpy(halves + i, &half, 2);
+    }
+
+    const RumBlitKernels* scalar = _rum_get_blit_kernels(RUM_CPU_SCALAR);
+    RumCpuLevel supported = _rum_detect_cpu_level();
+    for(RumCpuLevel level = RUM_CPU_SCALAR + 1; ok && level <= supported; ++level) {
+        const RumBlitKernels* kernels = _rum_get_blit_kernels(level);
+        const CheckedKernel checked[] = {
+            { "rgb_to_rgba",         kernels->rgb_to_rgba,         scalar->rgb_to_rgba },
+            { "rgba_to_rgba",        kernels->rgba_to_rgba,        scalar->rgba_to_rgba },
+            { "rgb_to_rgba_stream",  kernels->rgb_to_rgba_stream,  scalar->rgb_to_rgba_stream },
+            { "rgba_to_rgba_stream", kernels->rgba_to_rgba_stream, scalar->rgba_to_rgba_stream },
+            { "swap_rb",             kernels->swap_rb,             scalar->swap_rb },
+        };
+        for(uint32_t k = 0; k < sizeof(checked) / sizeof(checked[0]); ++k) {
+            uint64_t failures = 0;
+            for(uint64_t count = 0; count < CHECK_MAX_SPAN; ++count)
+                for(uint32_t src_offset = 0; src_offset < CHECK_MAX_OFFSET; ++src_offset)
+                    for(uint32_t dst_offset = 0; dst_offset < CHECK_MAX_OFFSET; ++dst_offset)
+                        failures += !check_span(&checked[k], src + src_offset, count, dst_offset, dst, expected, buffer_size);
+            char name[64];
+            snprintf(name, sizeof(name), "check/%s/%s", kernels->name, checked[k].name);
+            printf("%-40s %s\n", name, failures ? "FAILED" : "ok");
+            ok = ok && failures == 0;
+        }
+    }
+
+    uint64_t failures = 0;
+    // Every 565 value and every byte survive a round trip through their format, with RGBA in between
+    for(uint32_t value = 0; ok && value < 65536; ++value) {
+        uint16_t px = (uint16_t)value, back;
+        uint8_t rgba[4];
+        _rum_convert_row(rgba, RUM_RGBA, (const uint8_t*)&px, RUM_RGB565, 1);
+        _rum_convert_row((uint8_t*)&back, RUM_RGB565, rgba, RUM_RGBA, 1);
+        failures += back != px;
+    }
+    for(uint32_t value = 0; ok && value < 256; ++value) {
+        uint8_t px[4] = { (uint8_t)value, (uint8_t)(255 - value), (uint8_t)(value * 7), (uint8_t)(value ^ 0x55) };
+        uint8_t half[8], rgba[4];
+        _rum_convert_row(half, RUM_RGBA16F, px, RUM_RGBA, 1);
+        _rum_convert_row(rgba, RUM_RGBA, half, RUM_RGBA16F, 1);
+        failures += memcmp(rgba, px, 4) != 0;
+    }
+    // Spans longer than one of _rum_convert_row's chunks come out the same as converting pixel by pixel
+    const RumImageFormat pairs[][2] = {
+        { RUM_RGBA, RUM_RGB565 }, { RUM_RGB565, RUM_RGBA }, { RUM_RGBA, RUM_RGBA16F }, { RUM_RGBA16F, RUM_RGBA },
+    };
+    for(uint32_t p = 0; ok && p < sizeof(pairs) / sizeof(pairs[0]); ++p) {
+        const uint8_t* pair_src = pairs[p][1] == RUM_RGBA16F ? halves : src;
+        for(uint64_t count = 0; count < CHECK_MAX_SPAN; ++count)
+            for(uint32_t offset = 0; offset < CHECK_MAX_OFFSET; ++offset)
+                failures += !check_convert_span(pairs[p][0], pairs[p][1], pair_src + offset, count, offset,
+                        dst, expected, buffer_size);
+    }
+    if(ok)
+        printf("%-40s %s\n", "check/convert_row", failures ? "FAILED" : "ok");
+    ok = ok && failures == 0;
+
+    free(expected);
+    free(dst);
+    free(halves);
+    free(src);
+    return ok;
+}
+
+static void write_times(FILE* file, const char* name, const RumFrameTimes* times) {
+    fprintf(file, "\"%s\": { \"copy\": %.9f, \"upload\": %.9f, \"draw\": %.9f, \"swap\": %.9f, \"gpu\": %.9f, \"frame\": %.9f, \"upload_bytes\": %.0f, "
+            "\"queue_depth\": %.2f, \"queue_wait\": %.9f }",
+            name, times->copy, times->upload, times->draw, times->swap, times->gpu, times->frame, times->upload_bytes,
+            times->queue_depth, times->queue_wait);
+}
+
+static bool write_json(const char* path) {
+    FILE* file = fopen(path, "w");
+    if(!file)
+        return false;
+    fprintf(file, "{\n  \"screen\": [%d, %d],\n  \"workers\": %u,\n  \"frames\": %u,\n  \"results\": [\n",
+            SCREEN_WIDTH, SCREEN_HEIGHT, options.workers, options.frames);
+    for(uint32_t i = 0; i < result_count; ++i) {
+        const BenchResult* result = &results[i];
+        fprintf(file, "    { \"name\": \"%s\", \"iterations\": %llu, \"median\": %.9f, \"min\": %.9f, \"pixels\": %llu",
+                result->name, (unsigned long long)result->iterations, result->median, result->min, (unsigned long long)result->pixels);
+        if(result->pixels)
+            fprintf(file, ", \"mpixels_per_second\": %.3f", (double)result->pixels / result->median * 1e-6);
+        if(result->has_frame_stats) {
+            fprintf(file, ",\n      ");
+            write_times(file, "avg", &result->frame_stats.avg);
+            fprintf(file, ",\n      ");
+            write_times(file, "p99", &result->frame_stats.p99);
+        }
+        fprintf(file, " }%s\n", i + 1 < result_count ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    return fclose(file) == 0;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: rum_bench [-o results.json] [-f filter] [-n frames] [-w workers] [-p circles.ppm] [-s threads] [-k]\n");
+}
+
+int main(int argc, char** argv) {
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "-k") == 0) {
+            options.check = true;
+            continue;
+        }
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if(!value || argv[i][0] != '-' || argv[i][2] != '\0') {
+            usage();
+            return 1;
+        }
+        switch(argv[i][1]) {
+            case 'o': options.output = value; break;
+            case 'f': options.filter = value; break;
+            case 'n': options.frames = (uint32_t)strtoul(value, NULL, 10); break;
+            case 'w': options.workers = (uint32_t)strtoul(value, NULL, 10); break;
+            case 'p': options.ppm_path = value; break;
+            case 's': options.stress_threads = (uint32_t)strtoul(value, NULL, 10); break;
+            default: usage(); return 1;
+        }
+        ++i;
+    }
+    if(options.frames == 0)
+        options.frames = 1;
+
+    if(options.check)
+        return run_kernel_check() ? 0 : 1;
+    if(options.stress_threads > 0) {
+        bool ok = run_stress(RUM_BACKEND_OPENGL, "stress/opengl", options.stress_threads);
+        rum_set_async_present(true);
+        ok = run_stress(RUM_BACKEND_OPENGL, "stress/opengl_async", options.stress_threads) && ok;
+        ok = run_stress(RUM_BACKEND_SOFTWARE, "stress/software", options.stress_threads) && ok;
+        ok = run_lock_check(RUM_BACKEND_OPENGL, "stress/lock_opengl") && ok;
+        rum_set_async_present(true);
+        ok = run_lock_check(RUM_BACKEND_OPENGL, "stress/lock_opengl_async") && ok;
+        ok = run_lock_check(RUM_BACKEND_SOFTWARE, "stress/lock_software") && ok;
+        const RumImageFormat sink_formats[] = { RUM_RGBA, RUM_BGRA, RUM_RGB, RUM_RGB565, RUM_RGBA16F };
+        for(uint32_t i = 0; i < sizeof(sink_formats) / sizeof(sink_formats[0]); ++i) {
+            char name[64];
+            snprintf(name, sizeof(name), "stress/sink_%s", format_name(sink_formats[i]));
+            ok = run_sink_check(sink_formats[i], name) && ok;
+        }
+        return ok ? 0 : 1;
+    }
+
+    // Large enough for a full screen in the widest format, filled with something every format can decode
+    uint64_t source_size = (uint64_t)(MAX_SCREEN_WIDTH + 64) * (MAX_SCREEN_HEIGHT + 64) * 8;
+    source = malloc(source_size);
+    if(!source)
+        return 1;
+    for(uint64_t i = 0; i < source_size / 2; ++i) {
+        // Half floats between 0.25 and 0.5, and a byte pattern with no long runs for everything else
+        uint16_t value = (uint16_t)(0x3400 + (i * 7 & 0x3ff));
+        memcpy(source + i * 2, &value, 2);
+    }
+
+    printf("%-40s %10s %12s %12s %12s\n", "benchmark", "iterations", "median us", "min us", "Mpixel/s");
+    run_init_benchmarks();
+    run_copy_benchmarks();
+    run_frame_benchmarks();
+    run_readme_benchmarks();
+
+    free(source);
+    if(options.output && !write_json(options.output)) {
+        fprintf(stderr, "rum_bench: could not write %s\n", options.output);
+        return 1;
+    }
+    return 0;
+}
@@ -31,8 +31,17 @@
 #include <stdbool.h>
 
 typedef enum {
+    /** 8-bit grayscale */
+    RUM_R8 = 1,
+    /** 8-bit grayscale and alpha */
+    RUM_RG8 = 2,
     RUM_RGB = 3,
     RUM_RGBA = 4,
+    RUM_BGRA = 5,
+    /** 16-bit packed, red in the top 5 bits */
+    RUM_RGB565 = 6,
+    /** Half float per channel, values are expected in [0, 1] */
+    RUM_RGBA16F = 7,
 } RumImageFormat;
 
 typedef enum {
@@ -45,13 +54,278 @@ typedef enum {
 } RumFilter;
 
 
+typedef struct {
+    int64_t x, y;
+    int64_t width, height;
+} RumRect;
+
+/** Format the screen is kept in on both the CPU and the GPU, RUM_RGBA unless changed before rum_init.
+ *  Copies in any other format are converted to it, so picking the format the producer already uses
+ *  turns rum_copy_image into a plain copy. Compact formats also shrink every upload, the expansion to
+ *  RGBA happens in the fragment shader. Returns false once initialized */
+bool rum_set_screen_format(RumImageFormat format);
+
+typedef enum {
+    RUM_BACKEND_OPENGL = 0,
+    RUM_BACKEND_SOFTWARE,
+} RumBackend;
+
+/** How the screen reaches the window, RUM_BACKEND_OPENGL unless changed before rum_init. The software backend
+ *  never loads GL: rum_update_screen converts the changed parts of the screen image and puts them straight into
+ *  the window, with MIT-SHM on X11 when the server is local, or into memory under rum_init_headless. It has no
+ *  images, sprites or HUD, rum_create_image returns NULL. Returns false once initialized */
+bool rum_set_backend(RumBackend backend);
+
+/** Moves uploading, drawing and swapping onto a thread rum creates at rum_init, which takes over the GL context.
+ *  rum_update_screen then only hands the frame over and returns without waiting for vsync. Frames published
+ *  faster than the display shows them are merged, the newest one wins. Events are still pumped on the main
+ *  thread. rum_create_image, rum_destroy_image, rum_set_hud, rum_read_screen and opening or closing a window
+ *  borrow the context and wait for the frames handed over before them, rum_lock_framebuffer hands out the
+ *  screen image instead of GL memory. Only applies to RUM_BACKEND_OPENGL. If the thread cannot be created
+ *  rum_init turns this off again and presents on the main thread. Returns false once initialized */
+bool rum_set_async_present(bool enabled);
+
 bool rum_init(const char* screen_title, int32_t screen_width, int32_t screen_height);
 void rum_terminate();
+
+/** Same as rum_init, but nothing is shown: GLFW runs on its null platform with an OSMesa context, or an EGL
+ *  surfaceless one when OSMesa is missing, and frames are drawn into an off-screen framebuffer. Everything
+ *  else works the same, vsync is ignored since there is no display. Meant for CI and servers without one */
+bool rum_init_headless(int32_t screen_width, int32_t screen_height);
+
+/** Reads back the last frame rum_update_screen drew, sprites and HUD included, as screen_width * screen_height
+ *  RGBA pixels with row 0 at the bottom like rum_copy_image. Only headless screens can be read, false otherwise */
+bool rum_read_screen(uint8_t* pixels);
+
+/** Pumps the window system once and records what happened, meant to be called once per frame before
+ *  rum_check_event and rum_next_event. A frame that skips it is polled by its first rum_check_event */
+void rum_poll_events();
+
+/** Same as rum_poll_events, but sleeps until an event arrives, rum_wake_events is called or `timeout`
+ *  seconds pass, whichever comes first. A negative timeout waits without limit. Lets a display that
+ *  only changes on input or new data sit idle instead of spinning */
+void rum_wait_events(double timeout);
+
+/** Ends a rum_wait_events early, for example once a producer has new pixels. Safe to call from any thread */
+void rum_wake_events();
+
+/** Whether the window was asked to close or a key is held down, as of the last poll. Only reads state
+ *  recorded by rum_poll_events, so checking many keys costs next to nothing */
 bool rum_check_event(int event);
+
 void rum_update_screen();
 
+/** Copies an image onto the screen with its bottom left corner at (x, y), row 0 of the image is its bottom.
+ *  Several threads may copy at once as long as the parts of the screen they write don't overlap, e.g. one pane
+ *  each. All of them have to finish before rum_update_screen or any other call on the main thread. That includes
+ *  rum_set_worker_count, rum_set_change_detection, rum_lock_framebuffer and rum_unlock_framebuffer, which change
+ *  the pool, the mode or the image the copies use and are not safe to call while one runs */
 void rum_copy_image(RumImageFormat format, const uint8_t* image_data, uint64_t image_width, uint64_t image_height, int32_t x, int32_t y);
 
+/** Maps the pixel buffer the screen texture is uploaded from, so a frame can be drawn into it directly.
+ *  Pixels are in the screen format, rows are `pitch` bytes apart and row 0 is the bottom of the screen. The previous
+ *  contents are undefined, so the whole screen has to be written before rum_unlock_framebuffer.
+ *  The unlocked frame replaces anything copied with rum_copy_image before it and becomes the screen image that
+ *  later copies draw over, which costs one screen sized read back from the buffer. Both are main thread calls
+ *  that must not overlap a rum_copy_image on another thread */
+bool rum_lock_framebuffer(uint8_t** pixels, uint64_t* pitch);
+void rum_unlock_framebuffer();
+
+/** Hands a whole screen sized frame (screen format, row 0 at the bottom) over from any thread. The pixels are copied
+ *  into one of three buffers without taking a lock or waiting on the main thread, which then shows the newest
+ *  complete frame at its next rum_update_screen. A frame replaced by a newer one before that, or submitted while
+ *  every buffer is in use, is dropped and counted in RumStats. A shown frame replaces anything drawn on the main
+ *  thread before it, like rum_unlock_framebuffer, and becomes the screen image that later copies draw over. Costs
+ *  one screen sized copy on the main thread per shown frame. Returns false for dropped frames and before rum_init. Producers
+ *  have to stop before rum_terminate */
+bool rum_submit_frame(const uint8_t* pixels);
+
+/** Another window with a screen of its own, see rum_window_create */
+typedef struct RumWindow RumWindow;
+
+/** The window rum_init opened. rum_copy_image, rum_update_screen, rum_read_screen, rum_check_event, rum_draw_sprite,
+ *  rum_set_hud and rum_get_stats are the rum_window_ calls on it. Pacing, frame stats and the frames in flight
+ *  limit only apply to this window */
+RumWindow* rum_get_default_window();
+
+/** Opens one more window after rum_init, headless ones under rum_init_headless. It has a screen, dirty cells,
+ *  upload ring, sprite queue, HUD and RumStats of its own, its screen is in the screen format and starts out
+ *  black. The GL context is shared with the default window's, so the shaders and the quad are not created again.
+ *  A window follows the default window's vsync: rum_window_update draws it, and it is swapped right after the
+ *  default window's next vsynced swap, so update it before rum_update_screen. The window itself swaps with an
+ *  interval of 0 to keep the one wait per frame, so a swap that misses the blanking interval can still tear,
+ *  and while vsync is off it tears like the default window. Under async present its frames are drawn and
+ *  swapped on the present thread as well. Returns NULL on failure and on the software backend */
+RumWindow* rum_window_create(const char* title, int32_t width, int32_t height);
+/** Closes a window from rum_window_create, the ones still open are closed by rum_terminate */
+void rum_window_destroy(RumWindow* window);
+
+/** Like rum_copy_image into the window's screen, several threads may copy into disjoint parts of it at once */
+void rum_window_copy_image(RumWindow* window, RumImageFormat format, const uint8_t* image_data, uint64_t image_width, uint64_t image_height, int32_t x, int32_t y);
+/** Like rum_update_screen for the window, uploads what was copied into it since its last update and draws its
+ *  sprites, or hands the frame to the present thread. It shows up at the default window's next swap */
+void rum_window_update(RumWindow* window);
+/** Like rum_read_screen for the window, width * height RGBA pixels */
+bool rum_window_read_screen(RumWindow* window, uint8_t* pixels);
+/** Like rum_check_event for the window, RUM_EVENT_QUIT is its own close button and keys are the ones held while
+ *  it has the focus */
+bool rum_window_check_event(RumWindow* window, int event);
+
+/** Image kept in its own GPU texture, see rum_create_image */
+typedef struct RumImage RumImage;
+
+/** Uploads an image once and keeps it on the GPU, drawing it does not copy or upload any pixels.
+ *  Rows start at the bottom like in rum_copy_image. Returns NULL on failure */
+RumImage* rum_create_image(RumImageFormat format, const uint8_t* image_data, uint64_t image_width, uint64_t image_height);
+void rum_destroy_image(RumImage* image);
+
+/** Queues the image to be drawn at (x, y) by the next rum_update_screen, on top of the screen and of the
+ *  images queued before it. Alpha is blended */
+void rum_draw_image(RumImage* image, int32_t x, int32_t y);
+
+/** Queues the `source` part of the image (all of it when NULL), scaled by `scale`, like rum_draw_image.
+ *  Sprites are batched in one instance buffer per frame and every run of sprites from the same image is a
+ *  single draw call, so packing many sprites into one atlas image and drawing them back to back is fastest */
+void rum_draw_sprite(RumImage* image, int32_t x, int32_t y, const RumRect* source, float scale);
+/** Like rum_draw_sprite, queued on the window and drawn by its next rum_window_update */
+void rum_window_draw_sprite(RumWindow* window, RumImage* image, int32_t x, int32_t y, const RumRect* source, float scale);
+
+/** Seconds spent in each part of a frame, every field is a double so they can be summarized alike */
+typedef struct {
+    /** CPU time in rum_copy_image calls since the previous sampled frame */
+    double copy;
+    /** CPU time of rum_update_screen uploading the screen, drawing it with the sprites, and swapping */
+    double upload;
+    double draw;
+    double swap;
+    /** GPU time of the upload and draw, from the newest timer query that was already finished (two frames back) */
+    double gpu;
+    /** Time between the ends of this frame and the previous one, the same as rum_get_frame_delta */
+    double frame;
+    /** Bytes sent to the screen texture */
+    double upload_bytes;
+    /** Frames the GPU had not finished after this one was swapped, this one included, and the time spent waiting
+     *  for them to drain down to the rum_set_max_frames_in_flight limit. Only measured while there is a limit */
+    double queue_depth;
+    double queue_wait;
+} RumFrameTimes;
+
+typedef struct {
+    /** Frames in the window the summaries cover */
+    uint32_t frame_count;
+    RumFrameTimes last;
+    RumFrameTimes min, avg, p99;
+} RumFrameStats;
+
+/** Records RumFrameTimes for the last `frames` frames, 0 (the default) turns it off again. While off,
+ *  nothing is timed or queried. Changing the window drops the samples collected so far. Frames that
+ *  RUM_PRESENT_ON_CHANGE skips are left out, they only show up in RumStats.frames_skipped */
+void rum_set_frame_stats_window(uint32_t frames);
+
+/** Latest frame and min, average and 99th percentile over the window, false if nothing was recorded */
+bool rum_get_frame_stats(RumFrameStats* stats);
+
+/** Overlay in the top left corner with a graph of the last 120 frame times, FPS, upload MB/s and the
+ *  share of the screen changed per frame. It is drawn over the finished frame and never into the screen
+ *  image, so it does not change what it measures. Needs rum_init first */
+void rum_set_hud(bool enabled);
+/** The same overlay on the window, measuring its own updates */
+void rum_window_set_hud(RumWindow* window, bool enabled);
+
+/** Records rum's phases (event polling, blits, upload, draw, swap, frame pacing) and the zones below into
+ *  an in-memory ring that keeps the latest 64k events. Off by default, and compiled out entirely when
+ *  rum is built with RUM_NO_TRACE */
+void rum_set_trace(bool enabled);
+
+/** Zones of the calling thread shown next to rum's own, `name` must stay valid until the trace is dumped.
+ *  Safe to call from any thread, every begin needs a matching end on the same thread */
+void rum_trace_begin(const char* name);
+void rum_trace_end();
+
+/** Writes the recorded events as Chrome Trace Event JSON, which chrome://tracing and Perfetto open */
+bool rum_trace_dump(const char* path);
+
+typedef enum {
+    /** Every rum_update_screen draws and swaps */
+    RUM_PRESENT_ALWAYS = 0,
+    /** rum_update_screen returns without drawing or swapping when the screen image, the queued sprites
+     *  and the window contents are all the same as last frame. A skipped frame does not wait for vsync,
+     *  so the loop should wait on something else, like rum_wait_events */
+    RUM_PRESENT_ON_CHANGE,
+} RumPresentMode;
+
+void rum_set_present_mode(RumPresentMode mode);
+
+/** Syncs swaps to the display refresh, on by default. Can be called before rum_init */
+void rum_set_vsync(bool enabled);
+
+/** Makes rum_update_screen hold each frame until 1/fps seconds after the previous one, 0 turns it off.
+ *  It sleeps for most of the wait and spins the last millisecond, so frames end within microseconds
+ *  of their deadline. Works with vsync off too, and paces skipped frames of RUM_PRESENT_ON_CHANGE */
+void rum_set_target_fps(double fps);
+
+/** Limits how many swapped frames the driver may queue ahead of the GPU, 0 (the default) leaves it to the driver.
+ *  Each swap is followed by a fence, and rum_update_screen waits until the frame `frames` back is finished, so
+ *  input sampled for the next frame is at most that many frames away from the screen. 1 gives the lowest
+ *  latency and 2 or 3 keep the GPU busy. At most 8 frames are tracked, larger values are clamped to 8.
+ *  The queue depth and the waits show up in RumFrameTimes and RumStats. With rum_set_async_present the
+ *  present thread waits instead. No effect on the software backend */
+void rum_set_max_frames_in_flight(uint32_t frames);
+
+/** Seconds since rum_init on a monotonic clock */
+double rum_get_time();
+
+/** Seconds between the ends of the last two rum_update_screen calls */
+double rum_get_frame_delta();
+
+typedef struct {
+    /** rum_update_screen calls */
+    uint64_t frames;
+    /** Frames RUM_PRESENT_ON_CHANGE did not draw because nothing changed */
+    uint64_t frames_skipped;
+    /** Texture uploads issued, and the bytes they sent */
+    uint64_t uploads;
+    uint64_t upload_bytes;
+    /** Uploads that had to wait for the GPU to release a buffer of the upload ring, and for how long in seconds */
+    uint64_t upload_waits;
+    double upload_wait_time;
+    /** Tiles checked by the change detection mode, and how many of them differed */
+    uint64_t tiles_compared;
+    uint64_t tiles_changed;
+    /** Frames held by rum_set_target_fps, and how far their length was from the target in seconds */
+    uint64_t paced_frames;
+    double pacing_error_total;
+    double pacing_error_max;
+    /** Sprites and images drawn, and the instanced draw calls they took */
+    uint64_t sprites;
+    uint64_t sprite_draw_calls;
+    /** Frames passed to rum_submit_frame, and how many of them were never shown */
+    uint64_t frames_submitted;
+    uint64_t frames_dropped;
+    /** Frames actually drawn and swapped, fewer than `frames` when frames were skipped or merged */
+    uint64_t frames_presented;
+    /** Frames that waited for the GPU under rum_set_max_frames_in_flight, for how long in seconds, and the deepest
+     *  queue seen */
+    uint64_t frame_waits;
+    double frame_wait_time;
+    uint64_t frame_queue_depth_max;
+} RumStats;
+
+/** Counters accumulated since rum_init */
+void rum_get_stats(RumStats* stats);
+/** Counters of the window since it was opened */
+void rum_window_get_stats(RumWindow* window, RumStats* stats);
+
+/** Splits the screen into 64x64 tiles and makes rum_copy_image compare every tile it covers with the
+ *  current contents, only the tiles that differ are written and uploaded. Meant for producers that
+ *  resend whole frames where little changes, the compare cost shows up in RumStats. Not while a copy runs */
+void rum_set_change_detection(bool enabled);
+
+/** Number of extra threads rum_copy_image may use for large blits, 0 (the default) keeps it serial.
+ *  Can be called before rum_init to configure the pool it creates. After rum_init it replaces the pool and
+ *  frees the old one right away, so it may only be called on the main thread while no rum_copy_image runs */
+void rum_set_worker_count(uint32_t count);
+
 typedef enum {
     /** Unknown Event */
     RUM_EVENT_UNKNOWN                = -1,
@@ -187,4 +461,24 @@ typedef enum {
 #define RUM_EVENT_KEY_START RUM_EVENT_KEY_SPACE
 #define RUM_EVENT_KEY_LAST RUM_EVENT_KEY_MENU
 
+typedef enum {
+    RUM_ACTION_PRESS = 0,
+    RUM_ACTION_RELEASE,
+    /** Key held long enough for the system to repeat it */
+    RUM_ACTION_REPEAT,
+} RumEventAction;
+
+typedef struct {
+    RumEvent event;
+    RumEventAction action;
+    /** Seconds since rum_init */
+    double time;
+    /** Window the key was pressed in or whose close button was clicked */
+    RumWindow* window;
+} RumInputEvent;
+
+/** Takes the oldest event recorded by rum_poll_events off the queue, false once it is empty.
+ *  Quitting shows up as RUM_EVENT_QUIT with RUM_ACTION_PRESS. The queue keeps the latest 256 events */
+bool rum_next_event(RumInputEvent* event);
+
 #endif // RUM_H_
\ No newline at end of file
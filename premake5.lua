@@ -3,6 +3,16 @@ workspace "Rum"
     configurations { "Debug", "Release" }
     toolset "clang"
 
+    -- For `rum_bench -s`, which copies into the screen from several threads at once
+    newoption {
+        trigger = "tsan",
+        description = "Build everything with ThreadSanitizer"
+    }
+    filter "options:tsan"
+        buildoptions { "-fsanitize=thread" }
+        linkoptions { "-fsanitize=thread" }
+    filter {}
+
 project "rum"
     kind "StaticLib"
     objdir "build/obj/"
@@ -10,8 +20,31 @@ project "rum"
     language "C"
     location "build/scripts"
 
+    -- Tracing costs one branch per zone while off, this drops it completely
+    newoption {
+        trigger = "no-trace",
+        description = "Build rum without rum_set_trace support"
+    }
+    filter "options:no-trace"
+        defines { "RUM_NO_TRACE" }
+    filter {}
+
+    -- The software backend uses MIT-SHM from libXext, without it every frame goes through XPutImage
+    newoption {
+        trigger = "no-xshm",
+        description = "Build rum without libXext, the software backend then never uses MIT-SHM"
+    }
+    filter "options:no-xshm"
+        defines { "RUM_NO_XSHM" }
+    filter {}
+
     files {
         "src/rum.c",
+        "src/rum_blit.c",
+        "src/rum_thread.c",
+        "src/rum_trace.c",
+        "src/rum_software.c",
+        "src/rum_internal.h",
 
         "src/backends/glad.c",
 		"src/backends/GLFW/glfw3.h",
@@ -83,10 +116,58 @@ project "rum"
 			"src/backends/osmesa_context.c",
 			"src/backends/linux_joystick.c"
         }
+        -- GLFW compiles against the Xrandr, Xinerama, XInput2, Xcursor and XKB headers but loads those
+        -- libraries at runtime, so only their development headers are needed, e.g. libxrandr-dev
         defines {
             "_GLFW_X11"
         }
         links {
             "X11",
-            "m"
-        }
\ No newline at end of file
+            "m",
+            "pthread"
+        }
+
+    filter { "system:linux", "not options:no-xshm" }
+        links {
+            "Xext"
+        }
+project "rum_bench"
+    kind "ConsoleApp"
+    objdir "build/obj/"
+    targetdir "build/bin/"
+    language "C"
+    location "build/scripts"
+    -- The README workload loads circles.ppm from the repository root
+    debugdir "."
+
+    files {
+        "bench/rum_bench.c",
+    }
+
+    -- `-k` checks the blit kernels against each other, they are only declared in rum_internal.h
+    includedirs {
+        "include",
+        "src",
+    }
+
+    links {
+        "rum",
+    }
+
+    filter "system:windows"
+        links {
+			"Dwmapi"
+		}
+
+    filter "system:linux"
+        links {
+            "X11",
+            "m",
+            "pthread",
+            "dl"
+        }
+
+    filter { "system:linux", "not options:no-xshm" }
+        links {
+            "Xext"
+        }
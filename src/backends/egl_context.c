@@ -135,8 +135,9 @@ static GLFWbool chooseEGLConfig(const _GLFWctxconfig* ctxconfig,
         if (getEGLConfigAttrib(n, EGL_COLOR_BUFFER_TYPE) != EGL_RGB_BUFFER)
             continue;
 
-        // Only consider window EGLConfigs
-        if (!(getEGLConfigAttrib(n, EGL_SURFACE_TYPE) & EGL_WINDOW_BIT))
+        // Only consider window EGLConfigs, unless there is no window system
+        if (_glfw.egl.platform != EGL_PLATFORM_SURFACELESS_MESA &&
+            !(getEGLConfigAttrib(n, EGL_SURFACE_TYPE) & EGL_WINDOW_BIT))
             continue;
 
 #if defined(_GLFW_X11)
@@ -288,6 +289,10 @@ static void swapBuffersEGL(_GLFWwindow* window)
     }
 #endif
 
+    // NOTE: Surfaceless contexts render only into framebuffer objects
+    if (window->context.egl.surface == EGL_NO_SURFACE)
+        return;
+
     eglSwapBuffers(_glfw.egl.display, window->context.egl.surface);
 }
 
@@ -478,6 +483,8 @@ GLFWbool _glfwInitEGL(void)
             _glfwStringInExtensionString("EGL_ANGLE_platform_angle_vulkan", extensions);
         _glfw.egl.ANGLE_platform_angle_metal =
             _glfwStringInExtensionString("EGL_ANGLE_platform_angle_metal", extensions);
+        _glfw.egl.MESA_platform_surfaceless =
+            _glfwStringInExtensionString("EGL_MESA_platform_surfaceless", extensions);
     }
 
     if (_glfw.egl.EXT_platform_base)
@@ -533,6 +540,8 @@ GLFWbool _glfwInitEGL(void)
         extensionSupportedEGL("EGL_KHR_context_flush_control");
     _glfw.egl.EXT_present_opaque =
         extensionSupportedEGL("EGL_EXT_present_opaque");
+    _glfw.egl.KHR_surfaceless_context =
+        extensionSupportedEGL("EGL_KHR_surfaceless_context");
 
     return GLFW_TRUE;
 }
@@ -709,9 +718,22 @@ GLFWbool _glfwCreateContextEGL(_GLFWwindow* window,
     SET_ATTRIB(EGL_NONE, EGL_NONE);
 
     native = _glfw.platform.getEGLNativeWindow(window);
+    if (_glfw.egl.platform == EGL_PLATFORM_SURFACELESS_MESA)
+    {
+        // NOTE: There is no window system to present to, so the context is
+        //       made current without a surface and renders to FBOs only
+        if (!_glfw.egl.KHR_surfaceless_context)
+        {
+            _glfwInputError(GLFW_API_UNAVAILABLE,
+                            "EGL: Surfaceless platform requires EGL_KHR_surfaceless_context");
+            return GLFW_FALSE;
+        }
+
+        window->context.egl.surface = EGL_NO_SURFACE;
+    }
     // HACK: ANGLE does not implement eglCreatePlatformWindowSurfaceEXT
     //       despite reporting EGL_EXT_platform_base
-    if (_glfw.egl.platform && _glfw.egl.platform != EGL_PLATFORM_ANGLE_ANGLE)
+    else if (_glfw.egl.platform && _glfw.egl.platform != EGL_PLATFORM_ANGLE_ANGLE)
     {
         window->context.egl.surface =
             eglCreatePlatformWindowSurfaceEXT(_glfw.egl.display, config, native, attribs);
@@ -722,7 +744,8 @@ GLFWbool _glfwCreateContextEGL(_GLFWwindow* window,
             eglCreateWindowSurface(_glfw.egl.display, config, native, attribs);
     }
 
-    if (window->context.egl.surface == EGL_NO_SURFACE)
+    if (window->context.egl.surface == EGL_NO_SURFACE &&
+        _glfw.egl.platform != EGL_PLATFORM_SURFACELESS_MESA)
     {
         _glfwInputError(GLFW_PLATFORM_ERROR,
                         "EGL: Failed to create window surface: %s",
@@ -179,6 +179,7 @@ typedef const GLubyte* (APIENTRY * PFNGLGETSTRINGIPROC)(GLenum,GLuint);
 #define EGL_PLATFORM_WAYLAND_EXT 0x31d8
 #define EGL_PRESENT_OPAQUE_EXT 0x31df
 #define EGL_PLATFORM_ANGLE_ANGLE 0x3202
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31dd
 #define EGL_PLATFORM_ANGLE_TYPE_ANGLE 0x3203
 #define EGL_PLATFORM_ANGLE_TYPE_OPENGL_ANGLE 0x320d
 #define EGL_PLATFORM_ANGLE_TYPE_OPENGLES_ANGLE 0x320e
@@ -809,6 +810,8 @@ struct _GLFWlibrary
         GLFWbool        ANGLE_platform_angle_d3d;
         GLFWbool        ANGLE_platform_angle_vulkan;
         GLFWbool        ANGLE_platform_angle_metal;
+        GLFWbool        MESA_platform_surfaceless;
+        GLFWbool        KHR_surfaceless_context;
 
         void*           handle;
 
@@ -24,31 +24,349 @@
  *
  ************************************************************************************/
 #include "rum.h"
+#include "rum_internal.h"
 
 #include <stdint.h>
 #include <stdbool.h>
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <memory.h>
+#include <string.h>
+#include <stdatomic.h>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+// ARB_buffer_storage is core in 4.4, newer than the loader, so it is fetched by hand
+#ifndef GL_MAP_PERSISTENT_BIT
+    #define GL_MAP_PERSISTENT_BIT 0x0040
+    #define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#define RUM_UPLOAD_RING_SIZE 3
+// Buffers of the rum_submit_frame mailbox: one shown, one waiting and one being written
+#define RUM_MAILBOX_SIZE 3
+// Dirty rects kept per frame, past this the cheapest pair is merged
+#define RUM_MAX_DIRTY_RECTS 32
+// Edge length in pixels of the tiles compared by the change detection mode
+#define RUM_TILE_SIZE 64
+// Edge length in pixels of the cells rum_copy_image marks dirty, uploads are rounded out to them
+#define RUM_DIRTY_CELL_SIZE 16
+// Once this much of the screen is dirty, one full upload beats many small ones
+#define RUM_DIRTY_FULL_UPLOAD_PERCENT 50
+// Input events kept between two rum_next_event drains, the oldest are dropped past this
+#define RUM_EVENT_QUEUE_SIZE 256
+// GPU timer queries in flight, results are read this many frames later so reading never waits
+#define RUM_GPU_QUERY_COUNT 3
+// Highest rum_set_max_frames_in_flight limit, and the size of the ring of swap fences behind it
+#define RUM_MAX_FRAMES_IN_FLIGHT 8
+// Frames shown in the HUD graph, and how often its text is refreshed in seconds
+#define RUM_HUD_FRAMES 120
+#define RUM_HUD_REFRESH 0.5
+// The frame limiter sleeps until this long before the deadline and spins the rest, sleeps overshoot by about this much
+#if defined(_WIN32)
+    #define RUM_PACING_SPIN_TIME 0.002
+#else
+    #define RUM_PACING_SPIN_TIME 0.001
+#endif
+
+// How each screen format is stored on the GPU. Formats without a matching texture layout are uploaded as
+// they are and put back in order by the fragment shader
+typedef enum {
+    RUM_SWIZZLE_NONE = 0,
+    RUM_SWIZZLE_BGRA = 1,
+    RUM_SWIZZLE_GRAY = 2,
+    RUM_SWIZZLE_GRAY_ALPHA = 3,
+} RumSwizzle;
+
+typedef struct {
+    GLenum internal_format;
+    GLenum format;
+    GLenum type;
+    RumSwizzle swizzle;
+} RumTextureFormat;
+
+static const RumTextureFormat texture_formats[] = {
+    [RUM_R8]      = { GL_R8,      GL_RED,  GL_UNSIGNED_BYTE,        RUM_SWIZZLE_GRAY },
+    [RUM_RG8]     = { GL_RG8,     GL_RG,   GL_UNSIGNED_BYTE,        RUM_SWIZZLE_GRAY_ALPHA },
+    [RUM_RGB]     = { GL_RGB8,    GL_RGB,  GL_UNSIGNED_BYTE,        RUM_SWIZZLE_NONE },
+    [RUM_RGBA]    = { GL_RGBA8,   GL_RGBA, GL_UNSIGNED_BYTE,        RUM_SWIZZLE_NONE },
+    [RUM_BGRA]    = { GL_RGBA8,   GL_RGBA, GL_UNSIGNED_BYTE,        RUM_SWIZZLE_BGRA },
+    [RUM_RGB565]  = { GL_RGB565,  GL_RGB,  GL_UNSIGNED_SHORT_5_6_5, RUM_SWIZZLE_NONE },
+    [RUM_RGBA16F] = { GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT,           RUM_SWIZZLE_NONE },
+};
+
+typedef void (APIENTRYP RumBufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+struct RumImage {
+    uint32_t texture;
+    uint64_t width, height;
+    RumImageFormat format;
+};
+
+// One sprite in the instance buffer, the screen rect is in pixels and the source in texture coordinates
+typedef struct {
+    float x, y, width, height;
+    float u0, v0, u1, v1;
+} RumSpriteInstance;
+
+// Consecutive sprites of the same image, drawn by one instanced call
+typedef struct {
+    RumImage* image;
+    uint32_t first, count;
+} RumSpriteRun;
+
+typedef struct {
+    RumSpriteInstance* instances;
+    uint32_t count, capacity;
+    RumSpriteRun* runs;
+    uint32_t run_count, run_capacity;
+} RumSpriteQueue;
+
+// One of the present thread's two copies of the screen image. `rects` are the parts not drawn yet, `stale` the ones
+// published into the other copy since this one was last brought up to date, which only the main thread touches
 typedef struct {
+    uint8_t* pixels;
+    RumRect rects[RUM_MAX_DIRTY_RECTS];
+    uint32_t count;
+    RumRect stale[RUM_MAX_DIRTY_RECTS];
+    uint32_t stale_count;
+    RumSpriteQueue sprites;
+} RumPublishedFrame;
+
+
+// Everything one screen needs: its window, the staging image and how it reaches the texture, what is drawn over it
+// and what it counted. The default window lives in the context, the ones of rum_window_create follow it in `next`.
+// Their contexts share the programs and the quad buffers with the default one, vertex arrays and framebuffers are
+// not shared between contexts so each window has its own
+struct RumWindow {
     GLFWwindow* glfw_window;
-    bool initialized;
-    uint32_t vertex_array, vertex_buffer, index_buffer, shader_program;
-    
+    uint32_t vertex_array;
+
     struct {
         uint32_t texture;
         uint8_t* data;
         uint64_t data_size;
         uint64_t width, height;
         RumImageFormat format;
-        bool updated;
+        uint32_t pixel_size;
     } image;
+
+    // Regions of the staging image changed since the last upload. rum_copy_image sets a bit per cell it writes,
+    // from any number of threads at once, and rum_update_screen turns the set bits into this frame's rects.
+    // Each row of cells starts a new word, so marking a rect costs one atomic OR per row and word
+    struct {
+        RumRect rects[RUM_MAX_DIRTY_RECTS];
+        uint32_t count;
+        atomic_uint_fast64_t* cells;
+        uint64_t columns, rows, words_per_row;
+        // Set once the texture no longer matches the staging image anywhere, the next upload from it is a full one
+        bool stale;
+    } dirty;
+
+    // Ring of pixel unpack buffers the texture is uploaded from, created on first use.
+    // Filling one slot overlaps with the GPU still reading the others
+    struct {
+        struct {
+            uint32_t buffer;
+            uint8_t* mapping;
+            GLsync fence;
+        } slots[RUM_UPLOAD_RING_SIZE];
+        uint32_t next;
+        bool created;
+        bool persistent;
+        bool locked;
+        bool pending;
+    } upload;
+
+    // Frames from rum_submit_frame. A producer claims a free buffer, fills it and swaps it into `ready`,
+    // rum_update_screen swaps it out again. Buffer numbers are index + 1 so that 0 means none
+    struct {
+        // RUM_MAILBOX_SIZE screen images in one block, allocated by the first submit
+        _Atomic(uint8_t*) pixels;
+        atomic_uint busy[RUM_MAILBOX_SIZE];
+        atomic_uint ready;
+        // Only touched by the main thread
+        uint32_t front;
+        atomic_uint_fast64_t submitted, dropped;
+    } mailbox;
+
+    // Tiles of the change detection mode, counted atomically since copies may run on several threads
+    struct {
+        uint64_t columns, rows;
+        atomic_uint_fast64_t compared, changed;
+    } tiles;
+
+    // Sprites queued this frame, drawn over the screen in call order from one instance buffer
+    struct {
+        uint32_t vertex_array, instance_buffer;
+        // The last drawn queue is kept to tell whether the next frame draws anything different
+        RumSpriteQueue queue, drawn;
+    } sprites;
+
+    // Overlay drawn after everything else, it only reads counters and never touches the screen image
+    struct {
+        bool enabled;
+        uint32_t instance_buffer;
+        double frame_times[RUM_HUD_FRAMES];
+        double upload_bytes[RUM_HUD_FRAMES];
+        double dirty_area[RUM_HUD_FRAMES];
+        uint32_t next, count;
+        uint64_t frame_upload_bytes;
+        int64_t frame_dirty_area;
+        // End of the last frame, the default window takes its frame times from the pacing instead
+        double frame_end;
+        double refreshed;
+        char lines[4][16];
+    } hud;
+
+    // Copies of the screen image handed to the present thread. The main thread publishes into `frames[next]`
+    // under the present lock while the present thread draws the other one without it, they trade places when
+    // the present thread takes a frame
+    struct {
+        RumPublishedFrame frames[2];
+        uint32_t next;
+        bool ready;
+    } published;
+
+    // Off-screen target under rum_init_headless
+    uint32_t framebuffer, color;
+    // Set when the window system lost the window contents, or anything else made the last frame stale
+    bool damaged;
+    // Drawn but not swapped yet, other windows are swapped right after the default window's swap
+    bool swap_pending;
+    // Keys held down in this window as of the last poll
+    uint64_t keys[(RUM_EVENT_KEY_LAST + 64) / 64];
+
+    RumStats stats;
+    // What the frame being uploaded and drawn adds to the counters, moved into `stats` under the present lock once
+    // it is drawn since the present thread draws without holding it
+    RumStats drawing;
+    RumWindow* next;
+};
+
+typedef struct {
+    // The window rum_init opens, first in the list of windows
+    RumWindow window;
+    bool initialized;
+    uint32_t vertex_buffer, index_buffer, shader_program;
+    const RumBlitKernels* blit;
+    uint64_t stream_threshold;
+    uint32_t worker_count;
+    RumWorkerPool* workers;
+    RumBufferStorageProc buffer_storage;
+    RumBackend backend;
+    // Only set on the software backend, none of the GL objects exist then
+    RumSoftwareTarget* software;
+    // rum_set_change_detection, for copies into every window
+    bool change_detection;
+
+    // Shared by the sprites of every window, each binds the quad and the instances in a vertex array of its own
+    struct {
+        uint32_t shader_program;
+        int32_t screen_size_location, swizzle_location, tint_location;
+    } sprites;
+
+    // Glyphs of the HUD, created by the first window that turns it on
+    RumImage* hud_font;
+
+    // Per-frame timings of the default window, only measured while the window is not 0
+    struct {
+        uint32_t window;
+        RumFrameTimes* samples;
+        uint32_t next, count;
+        RumFrameTimes current;
+        // Copies may come from other threads, their time is summed here in nanoseconds
+        atomic_uint_fast64_t copy_time;
+        uint64_t frame_upload_bytes;
+        uint32_t queries[RUM_GPU_QUERY_COUNT];
+        bool query_pending[RUM_GPU_QUERY_COUNT];
+        uint32_t query_next;
+        bool queries_created;
+        double gpu_time;
+    } timing;
+
+    // Fences after each swap of the default window for rum_set_max_frames_in_flight, oldest first. Only the thread
+    // holding the context touches them, the limit is set under the present lock
+    struct {
+        uint32_t limit;
+        GLsync fences[RUM_MAX_FRAMES_IN_FLIGHT];
+        uint32_t first, count;
+    } in_flight;
+
+    // Paces the default window, the other ones present whatever frame it waited for
+    struct {
+        bool vsync;
+        double target_period;
+        // When the current frame should end, and when the last one did
+        double deadline;
+        double frame_end;
+        double frame_delta;
+    } pacing;
+
+    // rum_init_headless, frames are drawn into each window's off-screen target instead of the window
+    struct {
+        bool enabled;
+    } headless;
+
+    RumPresentMode present_mode;
+
+    // Present thread of rum_set_async_present. It owns the GL context and draws the frames rum_update_screen and
+    // rum_window_update publish, everything it shares with the main thread is behind the mutex except while it
+    // uploads, draws and swaps
+    struct {
+        bool enabled;
+        // Set before the present thread starts and cleared after it exits, so both threads read it freely
+        bool running;
+        // Nesting of acquire_context on the main thread
+        uint32_t context_users;
+        RumThread thread;
+        RumMutex mutex;
+        RumCond wake, idle;
+        bool handoff, handed, quit;
+        // The default window skipped its frame, the other windows drawn before it are swapped without it
+        bool swap_windows;
+        // Swap interval the context was last given, rum_set_vsync only records the new one
+        bool vsync;
+    } async;
+
+    // Filled by the GLFW callbacks during the one poll per frame, read without touching GLFW again
+    struct {
+        RumInputEvent queue[RUM_EVENT_QUEUE_SIZE];
+        uint32_t head, count;
+        bool polled;
+    } events;
 } RumContext;
 
+// Blits below this many pixels stay on the calling thread, waking the workers costs more than the copy
+#define RUM_PARALLEL_MIN_PIXELS (256 * 1024)
+// Bands handed out per thread, a few more than one keeps a slow thread from holding up the rest
+#define RUM_BANDS_PER_THREAD 4
+
+// A NULL convert kernel means the formats have no direct path and go through _rum_convert_row
+typedef struct {
+    RumRowKernel convert;
+    RumImageFormat src_format, dst_format;
+    const uint8_t* src;
+    uint8_t* dst;
+    uint64_t src_pitch, dst_pitch;
+    uint64_t span, rows;
+    uint64_t rows_per_band;
+} RumBlitJob;
+
+typedef struct {
+    RumWindow* window;
+    RumRowKernel convert;
+    RumImageFormat src_format;
+    const uint8_t* src;
+    uint64_t src_pitch;
+    uint64_t src_bpp;
+    bool same_format;
+    RumRect rect;
+    int64_t first_column, last_column;
+    int64_t first_row;
+} RumTileJob;
+
 const char* vert_shader_source = 
     "#version 330 core\n"
     "layout(location = 0) in vec2 a_position;\n"
@@ -60,45 +378,460 @@ const char* vert_shader_source =
         "gl_Position =vec4(a_position.x, a_position.y, 0.0, 1.0);\n"
     "}";
 
+// Places the shared unit quad on each instance's rect, shares the fragment shader with the screen
+const char* sprite_vert_shader_source =
+    "#version 330 core\n"
+    "layout(location = 0) in vec2 a_position;\n"
+    "layout(location = 2) in vec4 a_rect;\n"
+    "layout(location = 3) in vec4 a_source;\n"
+    "out vec2 v_texCoords;\n"
+    "uniform vec2 u_screen_size;\n"
+    "void main()\n"
+    "{\n"
+        "vec2 corner = a_position * 0.5 + 0.5;\n"
+        "v_texCoords = mix(a_source.xy, a_source.zw, corner);\n"
+        "vec2 position = a_rect.xy + corner * a_rect.zw;\n"
+        "gl_Position = vec4(position / u_screen_size * 2.0 - 1.0, 0.0, 1.0);\n"
+    "}";
+
 const char* frag_shader_source = 
     "#version 330 core\n"
     "layout(location = 0) out vec4 o_color;\n"
     "in vec2 v_texCoords;\n"
     "uniform sampler2D u_texture;\n"
+    "uniform int u_swizzle;\n"
+    "uniform vec4 u_tint;\n"
     "void main()\n"
     "{\n"
-        "o_color = texture(u_texture, v_texCoords);\n"
+        "vec4 texel = texture(u_texture, v_texCoords);\n"
+        "if(u_swizzle == 1) texel = texel.bgra;\n"
+        "else if(u_swizzle == 2) texel = vec4(texel.rrr, 1.0);\n"
+        "else if(u_swizzle == 3) texel = texel.rrrg;\n"
+        "o_color = texel * u_tint;\n"
     "}\n";
 
-static RumContext RUM = {0};
+static RumContext RUM = { .window.image.format = RUM_RGBA, .pacing.vsync = true };
+
+static void push_event(RumWindow* window, RumEvent event, RumEventAction action) {
+    if(RUM.events.count == RUM_EVENT_QUEUE_SIZE) {
+        RUM.events.head = (RUM.events.head + 1) % RUM_EVENT_QUEUE_SIZE;
+        RUM.events.count--;
+    }
+    uint32_t tail = (RUM.events.head + RUM.events.count) % RUM_EVENT_QUEUE_SIZE;
+    RUM.events.queue[tail] = (RumInputEvent){ event, action, glfwGetTime(), window };
+    RUM.events.count++;
+}
+
+// Every GLFW window points back at its RumWindow
+static void key_callback(GLFWwindow* glfw_window, int key, int scancode, int action, int mods) {
+    (void)scancode; (void)mods;
+    RumWindow* window = glfwGetWindowUserPointer(glfw_window);
+    if(key < (int)RUM_EVENT_KEY_START || key > RUM_EVENT_KEY_LAST)
+        return;
+    uint64_t bit = 1ull << (key % 64);
+    if(action == GLFW_RELEASE) {
+        window->keys[key / 64] &= ~bit;
+        push_event(window, (RumEvent)key, RUM_ACTION_RELEASE);
+    } else {
+        window->keys[key / 64] |= bit;
+        push_event(window, (RumEvent)key, action == GLFW_REPEAT ? RUM_ACTION_REPEAT : RUM_ACTION_PRESS);
+    }
+}
+
+static void close_callback(GLFWwindow* glfw_window) {
+    push_event(glfwGetWindowUserPointer(glfw_window), RUM_EVENT_QUIT, RUM_ACTION_PRESS);
+}
+
+// Exposed, uncovered or resized, whatever was presented before is gone
+static void refresh_callback(GLFWwindow* glfw_window) {
+    RumWindow* window = glfwGetWindowUserPointer(glfw_window);
+    window->damaged = true;
+}
+
+static void set_window_callbacks(RumWindow* window) {
+    glfwSetWindowUserPointer(window->glfw_window, window);
+    glfwSetKeyCallback(window->glfw_window, key_callback);
+    glfwSetWindowCloseCallback(window->glfw_window, close_callback);
+    glfwSetWindowRefreshCallback(window->glfw_window, refresh_callback);
+}
+
+bool rum_set_screen_format(RumImageFormat format) {
+    if(RUM.initialized || _rum_get_format_size(format) == 0)
+        return false;
+    RUM.window.image.format = format;
+    return true;
+}
+
+// Color target that stands in for the window's back buffer, it stays bound to the current context for the whole run
+static bool create_headless_target(uint64_t width, uint64_t height, uint32_t* framebuffer, uint32_t* color) {
+    glGenTextures(1, color);
+    glBindTexture(GL_TEXTURE_2D, *color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, (GLsizei) width, (GLsizei) height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glGenFramebuffers(1, framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, *framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, *color, 0);
+    glViewport(0, 0, (GLsizei) width, (GLsizei) height);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, framebuffer);
+        glDeleteTextures(1, color);
+        *framebuffer = 0;
+        *color = 0;
+        return false;
+    }
+    return true;
+}
+
+bool rum_set_backend(RumBackend backend) {
+    if(RUM.initialized || (backend != RUM_BACKEND_OPENGL && backend != RUM_BACKEND_SOFTWARE))
+        return false;
+    RUM.backend = backend;
+    return true;
+}
+
+bool rum_set_async_present(bool enabled) {
+    if(RUM.initialized)
+        return false;
+    RUM.async.enabled = enabled;
+    return true;
+}
+
+static void drop_swap_fence() {
+    glDeleteSync(RUM.in_flight.fences[RUM.in_flight.first]);
+    RUM.in_flight.first = (RUM.in_flight.first + 1) % RUM_MAX_FRAMES_IN_FLIGHT;
+    RUM.in_flight.count--;
+}
+
+// Fences the frame just swapped, then waits for the oldest queued frames until fewer than `limit` are left, which
+// is the frame `limit` back from the next one. Returns the queue depth after the swap and how long it waited
+static uint32_t limit_frames_in_flight(uint32_t limit, double* waited) {
+    *waited = 0.0;
+    // Finished frames leave the queue, what is left is how far the GPU is behind
+    while(RUM.in_flight.count > 0) {
+        GLenum status = glClientWaitSync(RUM.in_flight.fences[RUM.in_flight.first], 0, 0);
+        if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+        drop_swap_fence();
+    }
+    if(limit == 0) {
+        while(RUM.in_flight.count > 0)
+            drop_swap_fence();
+        return 0;
+    }
+
+    uint32_t last = (RUM.in_flight.first + RUM.in_flight.count) % RUM_MAX_FRAMES_IN_FLIGHT;
+    RUM.in_flight.fences[last] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    uint32_t depth = ++RUM.in_flight.count;
+    if(RUM.in_flight.count < limit)
+        return depth;
+    RUM_TRACE_BEGIN("rum_wait_frames");
+    double start = glfwGetTime();
+    while(RUM.in_flight.count >= limit) {
+        glClientWaitSync(RUM.in_flight.fences[RUM.in_flight.first], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        drop_swap_fence();
+    }
+    *waited = glfwGetTime() - start;
+    RUM_TRACE_END();
+    return depth;
+}
+
+static void present_thread(void* user);
+
+static void destroy_published_frames(RumWindow* window) {
+    for(int i = 0; i < 2; ++i) {
+        free(window->published.frames[i].pixels);
+        free(window->published.frames[i].sprites.instances);
+        free(window->published.frames[i].sprites.runs);
+    }
+    memset(&window->published, 0, sizeof(window->published));
+}
+
+// The present thread's copies of a window's screen, they start out black like the staging image
+static bool create_published_frames(RumWindow* window) {
+    for(int i = 0; i < 2; ++i) {
+        window->published.frames[i].pixels = calloc(1, window->image.data_size);
+        if(!window->published.frames[i].pixels) {
+            destroy_published_frames(window);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool start_present_thread() {
+    if(!create_published_frames(&RUM.window))
+        return false;
+    _rum_mutex_init(&RUM.async.mutex);
+    _rum_cond_init(&RUM.async.wake);
+    _rum_cond_init(&RUM.async.idle);
+    RUM.async.vsync = RUM.pacing.vsync;
+    // A context is current on one thread at a time, the present thread makes it its own
+    glfwMakeContextCurrent(NULL);
+    RUM.async.running = true;
+    if(!_rum_thread_create(&RUM.async.thread, present_thread, NULL)) {
+        RUM.async.running = false;
+        glfwMakeContextCurrent(RUM.window.glfw_window);
+        _rum_cond_destroy(&RUM.async.idle);
+        _rum_cond_destroy(&RUM.async.wake);
+        _rum_mutex_destroy(&RUM.async.mutex);
+        destroy_published_frames(&RUM.window);
+        return false;
+    }
+    return true;
+}
+
+// Lets the present thread draw what it was given last, then takes the context back
+static void stop_present_thread() {
+    if(!RUM.async.running)
+        return;
+    _rum_mutex_lock(&RUM.async.mutex);
+    RUM.async.quit = true;
+    _rum_cond_broadcast(&RUM.async.wake);
+    _rum_mutex_unlock(&RUM.async.mutex);
+    _rum_thread_join(&RUM.async.thread);
+    _rum_cond_destroy(&RUM.async.idle);
+    _rum_cond_destroy(&RUM.async.wake);
+    _rum_mutex_destroy(&RUM.async.mutex);
+    glfwMakeContextCurrent(RUM.window.glfw_window);
+    for(RumWindow* window = &RUM.window; window; window = window->next)
+        destroy_published_frames(window);
+    bool enabled = RUM.async.enabled;
+    memset(&RUM.async, 0, sizeof(RUM.async));
+    RUM.async.enabled = enabled;
+}
+
+// Guards what the present thread shares with the main thread, nothing to guard without it
+static void lock_present() {
+    if(RUM.async.running)
+        _rum_mutex_lock(&RUM.async.mutex);
+}
+
+static void unlock_present() {
+    if(RUM.async.running)
+        _rum_mutex_unlock(&RUM.async.mutex);
+}
+
+// Borrows the GL context for work outside of rum_update_screen, like creating images or reading the screen back.
+// The present thread first draws every frame it was given, then waits until release_context. Calls nest
+static void acquire_context() {
+    if(!RUM.async.running || RUM.async.context_users++ > 0)
+        return;
+    _rum_mutex_lock(&RUM.async.mutex);
+    RUM.async.handoff = true;
+    _rum_cond_broadcast(&RUM.async.wake);
+    while(!RUM.async.handed)
+        _rum_cond_wait(&RUM.async.idle, &RUM.async.mutex);
+    _rum_mutex_unlock(&RUM.async.mutex);
+    glfwMakeContextCurrent(RUM.window.glfw_window);
+}
+
+static void release_context() {
+    if(!RUM.async.running || --RUM.async.context_users > 0)
+        return;
+    glfwMakeContextCurrent(NULL);
+    _rum_mutex_lock(&RUM.async.mutex);
+    RUM.async.handoff = false;
+    RUM.async.handed = false;
+    _rum_cond_broadcast(&RUM.async.wake);
+    _rum_mutex_unlock(&RUM.async.mutex);
+}
+
+// The thread holding the GL context keeps the default window's current, a window's own is only made current for
+// the work on it
+static void enter_window(RumWindow* window) {
+    if(window != &RUM.window)
+        glfwMakeContextCurrent(window->glfw_window);
+}
+
+static void leave_window(RumWindow* window) {
+    if(window != &RUM.window)
+        glfwMakeContextCurrent(RUM.window.glfw_window);
+}
+
+// Staging image and dirty cells of a screen in the screen format. Allocated up front so that copies from several
+// threads never race to create them. The zeroed pages are only backed by memory once written, drawing through
+// rum_lock_framebuffer alone never touches them
+static bool create_window_screen(RumWindow* window, uint64_t width, uint64_t height) {
+    window->image.format = RUM.window.image.format;
+    window->image.width = width;
+    window->image.height = height;
+    window->image.pixel_size = _rum_get_format_size(window->image.format);
+    window->image.data_size = sizeof(char) * window->image.pixel_size * width * height;
+    window->image.data = calloc(1, window->image.data_size);
+    window->tiles.columns = (width + RUM_TILE_SIZE - 1) / RUM_TILE_SIZE;
+    window->tiles.rows = (height + RUM_TILE_SIZE - 1) / RUM_TILE_SIZE;
+    window->dirty.columns = (width + RUM_DIRTY_CELL_SIZE - 1) / RUM_DIRTY_CELL_SIZE;
+    window->dirty.rows = (height + RUM_DIRTY_CELL_SIZE - 1) / RUM_DIRTY_CELL_SIZE;
+    window->dirty.words_per_row = (window->dirty.columns + 63) / 64;
+    window->dirty.cells = calloc(window->dirty.words_per_row * window->dirty.rows, sizeof(atomic_uint_fast64_t));
+    window->damaged = true;
+    return window->image.data && window->dirty.cells;
+}
+
+static void destroy_window_screen(RumWindow* window) {
+    free(window->image.data);
+    free(window->dirty.cells);
+    free(atomic_load(&window->mailbox.pixels));
+    free(window->sprites.queue.instances);
+    free(window->sprites.queue.runs);
+    free(window->sprites.drawn.instances);
+    free(window->sprites.drawn.runs);
+}
+
+// Undoes what rum_init did before it got to the backend, so a failed init leaves nothing behind for the next one
+static bool abort_init() {
+    destroy_window_screen(&RUM.window);
+    _rum_pool_destroy(RUM.workers);
+    RUM.workers = NULL;
+    glfwDestroyWindow(RUM.window.glfw_window);
+    RumImageFormat format = RUM.window.image.format;
+    memset(&RUM.window, 0, sizeof(RUM.window));
+    RUM.window.image.format = format;
+    glfwTerminate();
+    return false;
+}
+
+// The staging image is what the software backend presents
+static bool init_software() {
+    RumWindow* window = &RUM.window;
+    RUM.software = _rum_software_create(RUM.headless.enabled ? NULL : window->glfw_window, RUM.blit, window->image.width, window->image.height);
+    if(!RUM.software)
+        return abort_init();
+    RUM.initialized = true;
+    return true;
+}
+
+// Black texture in the screen format that the window's screen is uploaded into, left bound
+static uint32_t create_screen_texture(RumWindow* window) {
+    uint32_t texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    const RumTextureFormat* texture_format = &texture_formats[window->image.format];
+    uint8_t* blank = calloc(1, window->image.data_size);
+    glTexImage2D(GL_TEXTURE_2D, 0, (GLint)texture_format->internal_format, (GLsizei) window->image.width,
+            (GLsizei) window->image.height, 0, texture_format->format, texture_format->type, (const void*) blank);
+    free(blank);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (GLint)RUM_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, (GLint)RUM_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    return texture;
+}
+
+// GL objects only this window uses, made in its context once the shared programs and buffers exist. The sprite
+// vertex array shares the quad and its indices, the per-instance pointers are set per run when drawing
+static bool create_window_objects(RumWindow* window) {
+    if(RUM.headless.enabled
+            && !create_headless_target(window->image.width, window->image.height, &window->framebuffer, &window->color))
+        return false;
+    glGenVertexArrays(1, &window->vertex_array);
+    glBindVertexArray(window->vertex_array);
+    glBindBuffer(GL_ARRAY_BUFFER, RUM.vertex_buffer);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (const void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (const void*)8);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, RUM.index_buffer);
+
+    glGenVertexArrays(1, &window->sprites.vertex_array);
+    glBindVertexArray(window->sprites.vertex_array);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, RUM.index_buffer);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (const void*)0);
+    glGenBuffers(1, &window->sprites.instance_buffer);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+
+    glActiveTexture(GL_TEXTURE0);
+    // Rows of the 1, 2 and 3 byte formats are not padded to 4 bytes
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    window->image.texture = create_screen_texture(window);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return true;
+}
+
+static void destroy_window_objects(RumWindow* window) {
+    for(uint32_t i = 0; window->upload.created && i < RUM_UPLOAD_RING_SIZE; ++i) {
+        if(window->upload.slots[i].mapping) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, window->upload.slots[i].buffer);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+        glDeleteSync(window->upload.slots[i].fence);
+        glDeleteBuffers(1, &window->upload.slots[i].buffer);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if(window->hud.enabled)
+        glDeleteBuffers(1, &window->hud.instance_buffer);
+    glDeleteBuffers(1, &window->sprites.instance_buffer);
+    glDeleteVertexArrays(1, &window->sprites.vertex_array);
+    glDeleteVertexArrays(1, &window->vertex_array);
+    if(window->framebuffer) {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &window->framebuffer);
+        glDeleteTextures(1, &window->color);
+    }
+    glDeleteTextures(1, &window->image.texture);
+}
 
 bool rum_init(const char* screen_title, int32_t screen_width, int32_t screen_height) {
     if(RUM.initialized)
         return false;
+    if(RUM.headless.enabled)
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
     if(!glfwInit())
         return false;
     
+    RumWindow* window = &RUM.window;
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-    RUM.glfw_window = glfwCreateWindow((int)screen_width, (int)screen_height, screen_title, NULL, NULL);
+    if(RUM.backend == RUM_BACKEND_SOFTWARE) {
+        // Nothing is drawn through a client API, the window only has to exist
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        window->glfw_window = glfwCreateWindow((int)screen_width, (int)screen_height, screen_title, NULL, NULL);
+    } else if(RUM.headless.enabled) {
+        // OSMesa renders in system memory without any driver, EGL surfaceless covers Mesa builds that lack it
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+        window->glfw_window = glfwCreateWindow((int)screen_width, (int)screen_height, screen_title, NULL, NULL);
+        if(!window->glfw_window) {
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+            window->glfw_window = glfwCreateWindow((int)screen_width, (int)screen_height, screen_title, NULL, NULL);
+        }
+    } else {
+        window->glfw_window = glfwCreateWindow((int)screen_width, (int)screen_height, screen_title, NULL, NULL);
+    }
+    if(!window->glfw_window) {
+        glfwTerminate();
+        return false;
+    }
+
+    if(!create_window_screen(window, (uint64_t)screen_width, (uint64_t)screen_height))
+        return abort_init();
+    RUM.blit = _rum_get_blit_kernels(_rum_detect_cpu_level());
+    RUM.stream_threshold = _rum_get_llc_size();
+    RUM.workers = _rum_pool_create(RUM.worker_count);
 
-    RUM.image.width = screen_width;
-    RUM.image.height = screen_height;
-    RUM.image.format = RUM_RGBA;
-    RUM.image.data_size = sizeof(char) * RUM.image.format * screen_width * screen_height;
-    RUM.image.data = malloc(RUM.image.data_size);
-    memset(RUM.image.data, 0, RUM.image.data_size);
+    set_window_callbacks(window);
+    if(RUM.backend == RUM_BACKEND_SOFTWARE)
+        return init_software();
 
-    glfwMakeContextCurrent(RUM.glfw_window);
+    glfwMakeContextCurrent(window->glfw_window);
+    if(!RUM.headless.enabled)
+        glfwSwapInterval(RUM.pacing.vsync ? 1 : 0);
 
 #if defined(__glad_h_)
     gladLoadGLLoader((GLADloadproc) glfwGetProcAddress);
 #endif
-
-    glGenVertexArrays(1, &RUM.vertex_array);
-    glBindVertexArray(RUM.vertex_array);
+    if(glfwExtensionSupported("GL_ARB_buffer_storage"))
+        RUM.buffer_storage = (RumBufferStorageProc) glfwGetProcAddress("glBufferStorage");
 
     uint32_t vert_shader = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(vert_shader, 1, &vert_shader_source, NULL);
@@ -113,105 +846,1673 @@ bool rum_init(const char* screen_title, int32_t screen_width, int32_t screen_hei
     glAttachShader(RUM.shader_program, vert_shader);
     glAttachShader(RUM.shader_program, frag_shader);
     glLinkProgram(RUM.shader_program);
+
+    uint32_t sprite_vert_shader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(sprite_vert_shader, 1, &sprite_vert_shader_source, NULL);
+    glCompileShader(sprite_vert_shader);
+    RUM.sprites.shader_program = glCreateProgram();
+    glAttachShader(RUM.sprites.shader_program, sprite_vert_shader);
+    glAttachShader(RUM.sprites.shader_program, frag_shader);
+    glLinkProgram(RUM.sprites.shader_program);
+    RUM.sprites.screen_size_location = glGetUniformLocation(RUM.sprites.shader_program, "u_screen_size");
+    RUM.sprites.swizzle_location = glGetUniformLocation(RUM.sprites.shader_program, "u_swizzle");
+    RUM.sprites.tint_location = glGetUniformLocation(RUM.sprites.shader_program, "u_tint");
+    glUseProgram(RUM.sprites.shader_program);
+    glUniform4f(RUM.sprites.tint_location, 1.0f, 1.0f, 1.0f, 1.0f);
+    glDeleteShader(sprite_vert_shader);
     glDeleteShader(vert_shader);
     glDeleteShader(frag_shader);
     glUseProgram(RUM.shader_program);
+    glUniform4f(glGetUniformLocation(RUM.shader_program, "u_tint"), 1.0f, 1.0f, 1.0f, 1.0f);
+    glUniform1i(glGetUniformLocation(RUM.shader_program, "u_texture"), 0);
+    glUniform1i(glGetUniformLocation(RUM.shader_program, "u_swizzle"), (GLint)texture_formats[window->image.format].swizzle);
 
-    glGenBuffers(1, &RUM.vertex_buffer);
-    glBindBuffer(GL_ARRAY_BUFFER, RUM.vertex_buffer);
+    // Buffers have no type, the indices go in through the array target since no vertex array is bound yet
     float vertices[] = {
         -1.0f, -1.0f, 0.0f, 0.0f,
          1.0f, -1.0f, 1.0f, 0.0f,
          1.0f,  1.0f, 1.0f, 1.0f,
         -1.0f,  1.0f, 0.0f, 1.0f,
     };
+    uint32_t indices[] = { 0, 1, 2, 2, 3, 0 };
+    glGenBuffers(1, &RUM.vertex_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, RUM.vertex_buffer);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (const void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (const void*)8);
-
     glGenBuffers(1, &RUM.index_buffer);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, RUM.index_buffer);
-    uint32_t indices[] = { 0, 1, 2, 2, 3, 0 };
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, 6 * sizeof(uint32_t), indices, GL_STATIC_DRAW);
-
-    glGenTextures(1, &RUM.image.texture);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, RUM.image.texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, (GLsizei) RUM.image.width, (GLsizei) RUM.image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, (const void*) RUM.image.data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (GLint)RUM_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, (GLint)RUM_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glBindBuffer(GL_ARRAY_BUFFER, RUM.index_buffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
-    glBindVertexArray(0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    if(!create_window_objects(window)) {
+        glDeleteBuffers(1, &RUM.vertex_buffer);
+        glDeleteBuffers(1, &RUM.index_buffer);
+        glDeleteProgram(RUM.sprites.shader_program);
+        glDeleteProgram(RUM.shader_program);
+        return abort_init();
+    }
 
+    // Without the thread frames are simply presented on the main thread,
+    // also when it cannot be created
+    if(RUM.async.enabled && !start_present_thread())
+        RUM.async.enabled = false;
     RUM.initialized = true;
     return true;
 }
 
+bool rum_init_headless(int32_t screen_width, int32_t screen_height) {
+    if(RUM.initialized)
+        return false;
+    RUM.headless.enabled = true;
+    if(!rum_init("rum", screen_width, screen_height)) {
+        glfwInitHint(GLFW_PLATFORM, GLFW_ANY_PLATFORM);
+        RUM.headless.enabled = false;
+        return false;
+    }
+    return true;
+}
+
+static void read_target(uint64_t width, uint64_t height, uint8_t* pixels) {
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, (GLsizei) width, (GLsizei) height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+}
+
+bool rum_read_screen(uint8_t* pixels) {
+    return rum_window_read_screen(&RUM.window, pixels);
+}
+
+bool rum_window_read_screen(RumWindow* window, uint8_t* pixels) {
+    if(!RUM.initialized || !RUM.headless.enabled || !window)
+        return false;
+    if(RUM.software)
+        return _rum_software_read(RUM.software, pixels);
+    RUM_TRACE_BEGIN("rum_read_screen");
+    acquire_context();
+    enter_window(window);
+    read_target(window->image.width, window->image.height, pixels);
+    leave_window(window);
+    release_context();
+    RUM_TRACE_END();
+    return true;
+}
+
 void rum_terminate()
 {
-    if(RUM.initialized) {
+    if(RUM.initialized && RUM.software) {
+        _rum_software_destroy(RUM.software);
+        RUM.software = NULL;
+    } else if(RUM.initialized) {
+        stop_present_thread();
+        while(RUM.window.next)
+            rum_window_destroy(RUM.window.next);
+        destroy_window_objects(&RUM.window);
+        if(RUM.hud_font) {
+            rum_destroy_image(RUM.hud_font);
+            RUM.hud_font = NULL;
+        }
         glDeleteBuffers(1, &RUM.vertex_buffer);
         glDeleteBuffers(1, &RUM.index_buffer);
-        glDeleteVertexArrays(1, &RUM.vertex_array);
-        glfwDestroyWindow(RUM.glfw_window);
+        glDeleteProgram(RUM.sprites.shader_program);
+        glDeleteProgram(RUM.shader_program);
+        if(RUM.timing.queries_created)
+            glDeleteQueries(RUM_GPU_QUERY_COUNT, RUM.timing.queries);
+        while(RUM.in_flight.count > 0)
+            drop_swap_fence();
+        RUM.in_flight.first = 0;
+    }
+    if(RUM.initialized) {
+        RUM.timing.queries_created = false;
+        free(RUM.timing.samples);
+        RUM.timing.samples = NULL;
+        glfwDestroyWindow(RUM.window.glfw_window);
         glfwTerminate();
-        free(RUM.image.data);
+        // Init hints outlive glfwTerminate, a later rum_init must not end up on the null platform
+        if(RUM.headless.enabled)
+            glfwInitHint(GLFW_PLATFORM, GLFW_ANY_PLATFORM);
+        memset(&RUM.headless, 0, sizeof(RUM.headless));
+        destroy_window_screen(&RUM.window);
+        _rum_pool_destroy(RUM.workers);
+        RUM.workers = NULL;
+        // Settings made before rum_init survive, everything owned by the old context is dropped
+        RumImageFormat format = RUM.window.image.format;
+        memset(&RUM.window, 0, sizeof(RUM.window));
+        RUM.window.image.format = format;
+        memset(&RUM.events, 0, sizeof(RUM.events));
+        RUM.initialized = false;
     }
 }
 
-bool rum_check_event(int event) {
+void rum_poll_events() {
+    RUM_TRACE_BEGIN("rum_poll_events");
     glfwPollEvents();
+    RUM_TRACE_END();
+    RUM.events.polled = true;
+}
+
+void rum_wait_events(double timeout) {
+    RUM_TRACE_BEGIN("rum_wait_events");
+    if(timeout < 0.0)
+        glfwWaitEvents();
+    else
+        glfwWaitEventsTimeout(timeout);
+    RUM_TRACE_END();
+    RUM.events.polled = true;
+}
+
+void rum_wake_events() {
+    if(RUM.initialized)
+        glfwPostEmptyEvent();
+}
+
+bool rum_check_event(int event) {
+    return rum_window_check_event(&RUM.window, event);
+}
+
+bool rum_window_check_event(RumWindow* window, int event) {
+    if(!window || !RUM.initialized)
+        return false;
+    // Loops that never call rum_poll_events still get exactly one poll per frame
+    if(!RUM.events.polled)
+        rum_poll_events();
     if(event == (int) RUM_EVENT_QUIT)
-        return glfwWindowShouldClose(RUM.glfw_window);
-    if((int)RUM_EVENT_KEY_START <= event && event <= RUM_EVENT_KEY_LAST) {
-        return glfwGetKey(RUM.glfw_window, event) == GLFW_PRESS || glfwGetKey(RUM.glfw_window, event) == GLFW_REPEAT;
-    }
+        return glfwWindowShouldClose(window->glfw_window);
+    if((int)RUM_EVENT_KEY_START <= event && event <= RUM_EVENT_KEY_LAST)
+        return (window->keys[event / 64] >> (event % 64)) & 1;
     return false;
 }
 
-void rum_copy_image(RumImageFormat src_format, const uint8_t* image_data, uint64_t image_width, uint64_t image_height, int32_t px, int32_t py) {
-    for(int dy = 0; dy < image_height; ++dy) {
-        int target_y = py + dy;
-        if(0 <= target_y && target_y < (int) RUM.image.height) {
-            for(int dx = 0; dx < image_width; ++dx) {
-                int target_x = px + dx;
-                if(0 <= target_x && target_x < RUM.image.width) {
-                    int source_index = (dy * image_width + dx) * RUM.image.format;
-                    int target_index = (target_y * RUM.image.width + target_x) * RUM.image.format;
-                    for(int i = 0; i < src_format; ++i) {
-                        RUM.image.data[target_index + i] = image_data[source_index + i];
-                    }
-                    if(src_format < 4) {
-                        RUM.image.data[target_index + 3] = 255;
-                    }
-                }
+bool rum_next_event(RumInputEvent* event) {
+    if(RUM.events.count == 0)
+        return false;
+    *event = RUM.events.queue[RUM.events.head];
+    RUM.events.head = (RUM.events.head + 1) % RUM_EVENT_QUEUE_SIZE;
+    RUM.events.count--;
+    return true;
+}
+
+static int64_t rect_area(const RumRect* rect) {
+    return rect->width * rect->height;
+}
+
+static RumRect rect_union(const RumRect* a, const RumRect* b) {
+    int64_t x0 = a->x < b->x ? a->x : b->x;
+    int64_t y0 = a->y < b->y ? a->y : b->y;
+    int64_t x1 = a->x + a->width > b->x + b->width ? a->x + a->width : b->x + b->width;
+    int64_t y1 = a->y + a->height > b->y + b->height ? a->y + a->height : b->y + b->height;
+    return (RumRect){ x0, y0, x1 - x0, y1 - y0 };
+}
+
+// Adds a rect to a list of at most RUM_MAX_DIRTY_RECTS
+static void add_rect(RumRect* rects, uint32_t* count, RumRect rect) {
+    for(;;) {
+        int64_t target = -1;
+        int64_t target_cost = 0;
+        for(uint32_t i = 0; i < *count; ++i) {
+            RumRect merged = rect_union(&rect, &rects[i]);
+            int64_t cost = rect_area(&merged) - rect_area(&rect) - rect_area(&rects[i]);
+            // Overlapping or adjacent rects merge for free, others only when the list is full
+            if(cost <= 0 || (*count == RUM_MAX_DIRTY_RECTS && (target < 0 || cost < target_cost))) {
+                target = i;
+                target_cost = cost;
+                if(cost <= 0)
+                    break;
             }
         }
+        if(target < 0)
+            break;
+        rect = rect_union(&rect, &rects[target]);
+        rects[target] = rects[--*count];
     }
+    rects[(*count)++] = rect;
+}
 
-    RUM.image.updated = true;
+// Clips an image placed at (px, py) against a screen of the given size, the result is in screen space
+static bool clip_to_screen(uint64_t screen_width, uint64_t screen_height, uint64_t image_width, uint64_t image_height,
+        int32_t px, int32_t py, RumRect* rect) {
+    int64_t x0 = px < 0 ? 0 : px;
+    int64_t y0 = py < 0 ? 0 : py;
+    int64_t x1 = (int64_t)px + (int64_t)image_width;
+    int64_t y1 = (int64_t)py + (int64_t)image_height;
+    if(x1 > (int64_t)screen_width)
+        x1 = (int64_t)screen_width;
+    if(y1 > (int64_t)screen_height)
+        y1 = (int64_t)screen_height;
+    if(x0 >= x1 || y0 >= y1)
+        return false;
+    rect->x = x0;
+    rect->y = y0;
+    rect->width = x1 - x0;
+    rect->height = y1 - y0;
+    return true;
 }
 
-void rum_update_screen()
-{
+// Sets the dirty bits of cells `first_column` to `last_column` of one row of cells
+static void mark_dirty_cells(RumWindow* window, uint64_t row, uint64_t first_column, uint64_t last_column) {
+    atomic_uint_fast64_t* words = window->dirty.cells + row * window->dirty.words_per_row;
+    for(uint64_t word = first_column / 64; word <= last_column / 64; ++word) {
+        uint64_t low = word == first_column / 64 ? first_column % 64 : 0;
+        uint64_t high = word == last_column / 64 ? last_column % 64 : 63;
+        uint64_t mask = (~0ull >> (63 - high)) & (~0ull << low);
+        // Panes that share a cell mostly find it marked already, reading first keeps them off each other's cache line
+        if((atomic_load_explicit(&words[word], memory_order_relaxed) & mask) != mask)
+            atomic_fetch_or_explicit(&words[word], mask, memory_order_release);
+    }
+}
+
+static void mark_dirty(RumWindow* window, const RumRect* rect) {
+    uint64_t first_column = (uint64_t)rect->x / RUM_DIRTY_CELL_SIZE;
+    uint64_t last_column = (uint64_t)(rect->x + rect->width - 1) / RUM_DIRTY_CELL_SIZE;
+    uint64_t last_row = (uint64_t)(rect->y + rect->height - 1) / RUM_DIRTY_CELL_SIZE;
+    for(uint64_t row = (uint64_t)rect->y / RUM_DIRTY_CELL_SIZE; row <= last_row; ++row)
+        mark_dirty_cells(window, row, first_column, last_column);
+}
+
+static void clear_dirty_cells(RumWindow* window) {
+    for(uint64_t i = 0; i < window->dirty.words_per_row * window->dirty.rows; ++i)
+        atomic_store_explicit(&window->dirty.cells[i], 0, memory_order_relaxed);
+}
+
+// Takes the dirty cells of this frame, runs of them in a row become one rect and add_rect merges those with
+// the rows above. False when nothing was copied since the last collection
+static bool collect_dirty_rects(RumWindow* window) {
+    window->dirty.count = 0;
+    for(uint64_t row = 0; row < window->dirty.rows; ++row) {
+        atomic_uint_fast64_t* words = window->dirty.cells + row * window->dirty.words_per_row;
+        int64_t y0 = (int64_t)row * RUM_DIRTY_CELL_SIZE;
+        int64_t y1 = y0 + RUM_DIRTY_CELL_SIZE < (int64_t)window->image.height ? y0 + RUM_DIRTY_CELL_SIZE : (int64_t)window->image.height;
+        int64_t run_start = -1;
+        uint64_t bits = 0;
+        for(uint64_t column = 0; column <= window->dirty.columns; ++column) {
+            if(column % 64 == 0 && column < window->dirty.columns) {
+                bits = atomic_load_explicit(&words[column / 64], memory_order_relaxed);
+                if(bits)
+                    bits = atomic_exchange_explicit(&words[column / 64], 0, memory_order_acquire);
+            }
+            bool dirty = column < window->dirty.columns && ((bits >> (column % 64)) & 1);
+            if(dirty && run_start < 0) {
+                run_start = (int64_t)column;
+            } else if(!dirty && run_start >= 0) {
+                int64_t x0 = run_start * RUM_DIRTY_CELL_SIZE;
+                int64_t x1 = (int64_t)column * RUM_DIRTY_CELL_SIZE < (int64_t)window->image.width ? (int64_t)column * RUM_DIRTY_CELL_SIZE : (int64_t)window->image.width;
+                add_rect(window->dirty.rects, &window->dirty.count, (RumRect){ x0, y0, x1 - x0, y1 - y0 });
+                run_start = -1;
+            }
+        }
+    }
+    if(window->dirty.count == 0)
+        return false;
+    if(window->dirty.stale) {
+        window->dirty.rects[0] = (RumRect){ 0, 0, (int64_t)window->image.width, (int64_t)window->image.height };
+        window->dirty.count = 1;
+        window->dirty.stale = false;
+    }
+    return true;
+}
+
+// Copies take the pool without holding anything, the contract in rum.h keeps them from running during the swap
+void rum_set_worker_count(uint32_t count) {
+    RUM.worker_count = count;
+    if(RUM.initialized) {
+        _rum_pool_destroy(RUM.workers);
+        RUM.workers = _rum_pool_create(count);
+    }
+}
+
+void rum_set_change_detection(bool enabled) {
+    RUM.change_detection = enabled;
+}
+
+static void blit_rows(const RumBlitJob* job, uint64_t first_row, uint64_t row_count) {
+    const uint8_t* src = job->src + first_row * job->src_pitch;
+    uint8_t* dst = job->dst + first_row * job->dst_pitch;
+    for(uint64_t row = 0; row < row_count; ++row) {
+        if(job->convert)
+            job->convert(dst, src, job->span);
+        else
+            _rum_convert_row(dst, job->dst_format, src, job->src_format, job->span);
+        src += job->src_pitch;
+        dst += job->dst_pitch;
+    }
+}
+
+static void blit_band(void* user, uint32_t band) {
+    const RumBlitJob* job = user;
+    uint64_t first_row = band * job->rows_per_band;
+    uint64_t row_count = job->rows - first_row;
+    if(row_count > job->rows_per_band)
+        row_count = job->rows_per_band;
+    RUM_TRACE_BEGIN("rum_blit_band");
+    blit_rows(job, first_row, row_count);
+    RUM_TRACE_END();
+}
+
+// Compares and copies one row of tiles, only rows that differ from the staging image are written
+static void copy_tile_row(void* user, uint32_t index) {
+    const RumTileJob* job = user;
+    RumWindow* window = job->window;
+    uint8_t converted[RUM_TILE_SIZE * 8];
+    uint64_t dst_pitch = window->image.width * window->image.pixel_size;
+    int64_t tile_row = job->first_row + index;
+    int64_t y0 = tile_row * RUM_TILE_SIZE > job->rect.y ? tile_row * RUM_TILE_SIZE : job->rect.y;
+    int64_t y1 = (tile_row + 1) * RUM_TILE_SIZE < job->rect.y + job->rect.height ? (tile_row + 1) * RUM_TILE_SIZE : job->rect.y + job->rect.height;
+    uint64_t changed_count = 0;
+
+    for(int64_t column = job->first_column; column < job->last_column; ++column) {
+        int64_t x0 = column * RUM_TILE_SIZE > job->rect.x ? column * RUM_TILE_SIZE : job->rect.x;
+        int64_t x1 = (column + 1) * RUM_TILE_SIZE < job->rect.x + job->rect.width ? (column + 1) * RUM_TILE_SIZE : job->rect.x + job->rect.width;
+        uint64_t span = (uint64_t)(x1 - x0);
+        bool changed = false;
+        for(int64_t y = y0; y < y1; ++y) {
+            const uint8_t* src = job->src + (y - job->rect.y) * job->src_pitch + (x0 - job->rect.x) * job->src_bpp;
+            uint8_t* dst = window->image.data + y * dst_pitch + x0 * window->image.pixel_size;
+            if(!job->same_format) {
+                if(job->convert)
+                    job->convert(converted, src, span);
+                else
+                    _rum_convert_row(converted, window->image.format, src, job->src_format, span);
+                src = converted;
+            }
+            if(memcmp(dst, src, span * window->image.pixel_size) != 0) {
+                memcpy(dst, src, span * window->image.pixel_size);
+                changed = true;
+            }
+        }
+        if(changed) {
+            RumRect tile = { x0, y0, x1 - x0, y1 - y0 };
+            mark_dirty(window, &tile);
+            changed_count++;
+        }
+    }
+    atomic_fetch_add_explicit(&window->tiles.compared, (uint64_t)(job->last_column - job->first_column), memory_order_relaxed);
+    atomic_fetch_add_explicit(&window->tiles.changed, changed_count, memory_order_relaxed);
+}
+
+static void copy_changed_tiles(RumWindow* window, RumImageFormat src_format, const uint8_t* src, uint64_t src_pitch, const RumRect* rect) {
+    RumTileJob job;
+    job.window = window;
+    job.convert = _rum_get_row_kernel(RUM.blit, window->image.format, src_format, false);
+    job.src_format = src_format;
+    job.src = src;
+    job.src_pitch = src_pitch;
+    job.src_bpp = _rum_get_format_size(src_format);
+    job.same_format = src_format == window->image.format;
+    job.rect = *rect;
+    job.first_column = rect->x / RUM_TILE_SIZE;
+    job.last_column = (rect->x + rect->width + RUM_TILE_SIZE - 1) / RUM_TILE_SIZE;
+    job.first_row = rect->y / RUM_TILE_SIZE;
+    int64_t last_row = (rect->y + rect->height + RUM_TILE_SIZE - 1) / RUM_TILE_SIZE;
+
+    if(RUM.workers && (uint64_t)rect_area(rect) >= RUM_PARALLEL_MIN_PIXELS)
+        _rum_pool_run(RUM.workers, copy_tile_row, &job, (uint32_t)(last_row - job.first_row));
+    else
+        for(int64_t row = job.first_row; row < last_row; ++row)
+            copy_tile_row(&job, (uint32_t)(row - job.first_row));
+}
+
+// Converts the part of an image at (px, py) that `rect` covers into a `dst_width` wide image in the screen format
+static void blit_image(RumWindow* window, uint8_t* dst, uint64_t dst_width, const RumRect* rect, RumImageFormat src_format,
+        const uint8_t* image_data, uint64_t image_width, int32_t px, int32_t py) {
+    uint64_t src_bpp = _rum_get_format_size(src_format);
+    RumBlitJob job;
+    job.src_format = src_format;
+    job.dst_format = window->image.format;
+    job.src_pitch = image_width * src_bpp;
+    job.dst_pitch = dst_width * window->image.pixel_size;
+    job.src = image_data + (rect->y - py) * job.src_pitch + (rect->x - px) * src_bpp;
+    job.dst = dst + rect->y * job.dst_pitch + rect->x * window->image.pixel_size;
+    job.span = rect->width;
+    job.rows = rect->height;
+
+    // Copies that cannot stay in the cache anyway are written around it
+    uint64_t pixel_count = (uint64_t)(rect->width * rect->height);
+    bool stream = pixel_count * window->image.pixel_size > RUM.stream_threshold;
+    job.convert = _rum_get_row_kernel(RUM.blit, window->image.format, src_format, stream);
+
+    if(RUM.workers && pixel_count >= RUM_PARALLEL_MIN_PIXELS) {
+        uint64_t band_count = (_rum_pool_get_worker_count(RUM.workers) + 1) * RUM_BANDS_PER_THREAD;
+        if(band_count > job.rows)
+            band_count = job.rows;
+        job.rows_per_band = (job.rows + band_count - 1) / band_count;
+        band_count = (job.rows + job.rows_per_band - 1) / job.rows_per_band;
+        _rum_pool_run(RUM.workers, blit_band, &job, (uint32_t)band_count);
+    } else if(rect->width == (int64_t)dst_width && rect->width == (int64_t)image_width) {
+        // Full-width rows are contiguous on both sides, so the whole rect is a single span
+        job.span *= job.rows;
+        blit_rows(&job, 0, 1);
+    } else {
+        blit_rows(&job, 0, job.rows);
+    }
+}
+
+static void copy_image(RumWindow* window, RumImageFormat src_format, const uint8_t* image_data, uint64_t image_width, uint64_t image_height, int32_t px, int32_t py) {
+    uint64_t src_bpp = _rum_get_format_size(src_format);
+    RumRect rect;
+    if(src_bpp == 0 || !clip_to_screen(window->image.width, window->image.height, image_width, image_height, px, py, &rect))
+        return;
+
+    if(RUM.change_detection) {
+        uint64_t src_pitch = image_width * src_bpp;
+        const uint8_t* src = image_data + (rect.y - py) * src_pitch + (rect.x - px) * src_bpp;
+        copy_changed_tiles(window, src_format, src, src_pitch, &rect);
+        return;
+    }
+
+    blit_image(window, window->image.data, window->image.width, &rect, src_format, image_data, image_width, px, py);
+    mark_dirty(window, &rect);
+}
+
+void rum_copy_image(RumImageFormat src_format, const uint8_t* image_data, uint64_t image_width, uint64_t image_height, int32_t px, int32_t py) {
+    rum_window_copy_image(&RUM.window, src_format, image_data, image_width, image_height, px, py);
+}
+
+void rum_window_copy_image(RumWindow* window, RumImageFormat src_format, const uint8_t* image_data, uint64_t image_width, uint64_t image_height, int32_t px, int32_t py) {
+    if(!window)
+        return;
+    RUM_TRACE_BEGIN("rum_copy_image");
+    // Frame stats follow the default window only
+    if(!RUM.timing.window || window != &RUM.window) {
+        copy_image(window, src_format, image_data, image_width, image_height, px, py);
+    } else {
+        double start = glfwGetTime();
+        copy_image(window, src_format, image_data, image_width, image_height, px, py);
+        atomic_fetch_add_explicit(&RUM.timing.copy_time, (uint64_t)((glfwGetTime() - start) * 1e9), memory_order_relaxed);
+    }
+    RUM_TRACE_END();
+}
+
+static bool create_upload_ring(RumWindow* window) {
+    if(window->upload.created)
+        return true;
+
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    window->upload.persistent = RUM.buffer_storage != NULL;
+    for(uint32_t i = 0; i < RUM_UPLOAD_RING_SIZE; ++i) {
+        glGenBuffers(1, &window->upload.slots[i].buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, window->upload.slots[i].buffer);
+        if(window->upload.persistent) {
+            RUM.buffer_storage(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)window->image.data_size, NULL, flags);
+            window->upload.slots[i].mapping = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)window->image.data_size, flags);
+            if(!window->upload.slots[i].mapping)
+                window->upload.persistent = false;
+        } else {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)window->image.data_size, NULL, GL_STREAM_DRAW);
+        }
+    }
+
+    // A failed persistent mapping drops the whole ring back to mapping once per upload
+    for(uint32_t i = 0; !window->upload.persistent && i < RUM_UPLOAD_RING_SIZE; ++i) {
+        if(window->upload.slots[i].mapping) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, window->upload.slots[i].buffer);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            window->upload.slots[i].mapping = NULL;
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    window->upload.created = true;
+    return true;
+}
+
+// Waits until the GPU is done with the next slot and returns where its pixels go
+static uint8_t* acquire_upload_slot(RumWindow* window) {
+    if(!create_upload_ring(window))
+        return NULL;
+
+    uint32_t index = window->upload.next;
+    if(window->upload.slots[index].fence) {
+        GLsync fence = window->upload.slots[index].fence;
+        if(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED) {
+            double start = glfwGetTime();
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            window->drawing.upload_waits++;
+            window->drawing.upload_wait_time += glfwGetTime() - start;
+        }
+        glDeleteSync(fence);
+        window->upload.slots[index].fence = NULL;
+    }
+
+    if(!window->upload.persistent) {
+        // The fence already guarantees the GPU is done with it, so the driver does not need to sync again
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, window->upload.slots[index].buffer);
+        window->upload.slots[index].mapping = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)window->image.data_size,
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    return window->upload.slots[index].mapping;
+}
+
+static void release_upload_slot(RumWindow* window) {
+    if(window->upload.persistent)
+        return;
+    uint32_t index = window->upload.next;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, window->upload.slots[index].buffer);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    window->upload.slots[index].mapping = NULL;
+}
+
+// Copies a rect between two screen-sized images
+static void copy_rect(RumWindow* window, uint8_t* dst, const uint8_t* src, const RumRect* rect) {
+    uint64_t pitch = window->image.width * window->image.pixel_size;
+    uint64_t offset = rect->y * pitch + rect->x * window->image.pixel_size;
+    uint64_t span = rect->width * window->image.pixel_size;
+    if(rect->width == (int64_t)window->image.width) {
+        memcpy(dst + offset, src + offset, span * rect->height);
+        return;
+    }
+    for(int64_t row = 0; row < rect->height; ++row)
+        memcpy(dst + offset + row * pitch, src + offset + row * pitch, span);
+}
+
+// Uploads rects of a `width` wide image in the screen format into the bound texture, `pixels` is client memory or
+// an offset into the bound unpack buffer. Returns the bytes uploaded
+static uint64_t upload_rects(RumWindow* window, const uint8_t* pixels, uint64_t width, const RumRect* rects, uint32_t count) {
+    const RumTextureFormat* texture_format = &texture_formats[window->image.format];
+    uint64_t bytes = 0;
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, (GLint)width);
+    for(uint32_t i = 0; i < count; ++i) {
+        const RumRect* rect = &rects[i];
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, (GLint)rect->x);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, (GLint)rect->y);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, (GLint)rect->x, (GLint)rect->y, (GLsizei)rect->width, (GLsizei)rect->height,
+                texture_format->format, texture_format->type, pixels);
+        bytes += rect_area(rect) * window->image.pixel_size;
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    return bytes;
+}
+
+// Uploads rects of the current slot into the bound texture and moves on to the next one
+static void submit_upload_slot(RumWindow* window, const RumRect* rects, uint32_t count) {
+    uint32_t index = window->upload.next;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, window->upload.slots[index].buffer);
+    window->drawing.upload_bytes += upload_rects(window, (const uint8_t*)0, window->image.width, rects, count);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    window->upload.slots[index].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    window->upload.next = (index + 1) % RUM_UPLOAD_RING_SIZE;
+    window->drawing.uploads++;
+}
+
+// Stages the rects through the upload ring, straight from client memory if no buffer could be mapped
+static void upload_from(RumWindow* window, const uint8_t* pixels, const RumRect* rects, uint32_t count) {
+    uint8_t* slot = acquire_upload_slot(window);
+    if(slot) {
+        for(uint32_t i = 0; i < count; ++i)
+            copy_rect(window, slot, pixels, &rects[i]);
+        release_upload_slot(window);
+        submit_upload_slot(window, rects, count);
+    } else {
+        window->drawing.upload_bytes += upload_rects(window, pixels, window->image.width, rects, count);
+        window->drawing.uploads++;
+    }
+}
+
+bool rum_lock_framebuffer(uint8_t** pixels, uint64_t* pitch) {
+    if(!RUM.initialized)
+        return false;
+    RumWindow* window = &RUM.window;
+    *pitch = window->image.width * window->image.pixel_size;
+    if(RUM.software || RUM.async.running) {
+        // Presenting reads the staging image, or the GL buffers belong to the present thread, so the frame is
+        // drawn straight into the staging image
+        window->upload.locked = true;
+        *pixels = window->image.data;
+        return true;
+    }
+    if(!window->upload.locked) {
+        if(!acquire_upload_slot(window))
+            return false;
+        window->upload.locked = true;
+    }
+    *pixels = window->upload.slots[window->upload.next].mapping;
+    return true;
+}
+
+void rum_unlock_framebuffer() {
+    RumWindow* window = &RUM.window;
+    if(!window->upload.locked)
+        return;
+    window->upload.locked = false;
+    if(RUM.software || RUM.async.running) {
+        RumRect screen = { 0, 0, (int64_t)window->image.width, (int64_t)window->image.height };
+        mark_dirty(window, &screen);
+    } else {
+        release_upload_slot(window);
+        // The frame also becomes the staging image, copies made after it draw over it and a later full upload
+        // from the staging image shows it instead of what was copied before the lock
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, window->upload.slots[window->upload.next].buffer);
+        glGetBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)window->image.data_size, window->image.data);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        window->upload.pending = true;
+        // Copies made before it are replaced, and the texture no longer matches the staging image anywhere
+        clear_dirty_cells(window);
+        window->dirty.stale = true;
+    }
+}
+
+bool rum_submit_frame(const uint8_t* pixels) {
+    if(!RUM.initialized)
+        return false;
+    RumWindow* window = &RUM.window;
+    uint8_t* buffers = atomic_load_explicit(&window->mailbox.pixels, memory_order_acquire);
+    if(!buffers) {
+        // Two producers may race for the first allocation, the loser frees its own
+        uint8_t* allocated = malloc(RUM_MAILBOX_SIZE * window->image.data_size);
+        if(!allocated)
+            return false;
+        if(atomic_compare_exchange_strong_explicit(&window->mailbox.pixels, &buffers, allocated, memory_order_acq_rel, memory_order_acquire))
+            buffers = allocated;
+        else
+            free(allocated);
+    }
+
+    atomic_fetch_add_explicit(&window->mailbox.submitted, 1, memory_order_relaxed);
+    uint32_t index = 0;
+    for(; index < RUM_MAILBOX_SIZE; ++index) {
+        unsigned int expected = 0;
+        if(atomic_compare_exchange_strong_explicit(&window->mailbox.busy[index], &expected, 1, memory_order_acquire, memory_order_relaxed))
+            break;
+    }
+    if(index == RUM_MAILBOX_SIZE) {
+        // Only happens with more producers writing at once than there are spare buffers
+        atomic_fetch_add_explicit(&window->mailbox.dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    memcpy(buffers + index * window->image.data_size, pixels, window->image.data_size);
+    uint32_t overtaken = atomic_exchange_explicit(&window->mailbox.ready, index + 1, memory_order_acq_rel);
+    if(overtaken) {
+        atomic_store_explicit(&window->mailbox.busy[overtaken - 1], 0, memory_order_release);
+        atomic_fetch_add_explicit(&window->mailbox.dropped, 1, memory_order_relaxed);
+    }
+    // A main loop sitting in rum_wait_events picks the frame up right away
+    rum_wake_events();
+    return true;
+}
+
+static const uint8_t* front_frame(RumWindow* window) {
+    uint8_t* buffers = atomic_load_explicit(&window->mailbox.pixels, memory_order_acquire);
+    return buffers + (window->mailbox.front - 1) * window->image.data_size;
+}
+
+// Newest submitted frame not shown yet, or NULL. The buffer stays owned by the main thread until the next one arrives
+static const uint8_t* take_submitted_frame(RumWindow* window) {
+    if(atomic_load_explicit(&window->mailbox.ready, memory_order_acquire) == 0)
+        return NULL;
+    // Only this thread empties `ready`, so the old front can be released first and a lone producer always finds a buffer
+    if(window->mailbox.front)
+        atomic_store_explicit(&window->mailbox.busy[window->mailbox.front - 1], 0, memory_order_release);
+    window->mailbox.front = atomic_exchange_explicit(&window->mailbox.ready, 0, memory_order_acq_rel);
+    return front_frame(window);
+}
+
+// A shown frame becomes the staging image, so copies made after it land on top of it instead of on the older
+// frame. It replaces whatever was copied or unlocked before it
+static void replace_staging_image(RumWindow* window, const uint8_t* pixels) {
+    RUM_TRACE_BEGIN("rum_replace_staging");
+    memcpy(window->image.data, pixels, window->image.data_size);
+    RUM_TRACE_END();
+    window->upload.pending = false;
+    clear_dirty_cells(window);
+}
+
+void rum_get_stats(RumStats* stats) {
+    rum_window_get_stats(&RUM.window, stats);
+}
+
+void rum_window_get_stats(RumWindow* window, RumStats* stats) {
+    if(!window) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    lock_present();
+    *stats = window->stats;
+    unlock_present();
+    stats->tiles_compared = atomic_load_explicit(&window->tiles.compared, memory_order_relaxed);
+    stats->tiles_changed = atomic_load_explicit(&window->tiles.changed, memory_order_relaxed);
+    stats->frames_submitted = atomic_load_explicit(&window->mailbox.submitted, memory_order_relaxed);
+    stats->frames_dropped = atomic_load_explicit(&window->mailbox.dropped, memory_order_relaxed);
+}
+
+RumImage* rum_create_image(RumImageFormat format, const uint8_t* image_data, uint64_t image_width, uint64_t image_height) {
+    if(!RUM.initialized || RUM.software || _rum_get_format_size(format) == 0 || image_width == 0 || image_height == 0)
+        return NULL;
+    RumImage* image = calloc(1, sizeof(RumImage));
+    if(!image)
+        return NULL;
+    image->width = image_width;
+    image->height = image_height;
+    image->format = format;
+
+    // Uploaded once in its own format, drawing it later touches no pixels on the CPU
+    const RumTextureFormat* texture_format = &texture_formats[format];
+    acquire_context();
+    glGenTextures(1, &image->texture);
+    glBindTexture(GL_TEXTURE_2D, image->texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, (GLint)texture_format->internal_format, (GLsizei)image_width, (GLsizei)image_height, 0,
+            texture_format->format, texture_format->type, (const void*)image_data);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (GLint)RUM_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, (GLint)RUM_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    release_context();
+    return image;
+}
+
+void rum_destroy_image(RumImage* image) {
+    if(!image)
+        return;
+    // Sprites of it still queued for this frame are skipped when drawing
+    for(RumWindow* window = &RUM.window; window; window = window->next) {
+        for(uint32_t i = 0; i < window->sprites.queue.run_count; ++i)
+            if(window->sprites.queue.runs[i].image == image)
+                window->sprites.queue.runs[i].image = NULL;
+        // A new image may reuse the address, the drawn queue can no longer be trusted to match the screen
+        window->damaged = true;
+    }
+    acquire_context();
+    glDeleteTextures(1, &image->texture);
+    release_context();
+    free(image);
+}
+
+// Grows `*items` to hold at least one more element, doubling like the other per-frame queues
+static bool reserve_one(void** items, uint32_t count, uint32_t* capacity, uint64_t item_size) {
+    if(count < *capacity)
+        return true;
+    uint32_t new_capacity = *capacity ? *capacity * 2 : 256;
+    void* new_items = realloc(*items, new_capacity * item_size);
+    if(!new_items)
+        return false;
+    *items = new_items;
+    *capacity = new_capacity;
+    return true;
+}
+
+void rum_draw_sprite(RumImage* image, int32_t x, int32_t y, const RumRect* source, float scale) {
+    rum_window_draw_sprite(&RUM.window, image, x, y, source, scale);
+}
+
+void rum_window_draw_sprite(RumWindow* window, RumImage* image, int32_t x, int32_t y, const RumRect* source, float scale) {
+    if(!window || !image)
+        return;
+    RumRect rect = source ? *source : (RumRect){ 0, 0, (int64_t)image->width, (int64_t)image->height };
+    if(!reserve_one((void**)&window->sprites.queue.instances, window->sprites.queue.count, &window->sprites.queue.capacity, sizeof(RumSpriteInstance)))
+        return;
+
+    RumSpriteRun* run = window->sprites.queue.run_count > 0 ? &window->sprites.queue.runs[window->sprites.queue.run_count - 1] : NULL;
+    if(!run || run->image != image) {
+        if(!reserve_one((void**)&window->sprites.queue.runs, window->sprites.queue.run_count, &window->sprites.queue.run_capacity, sizeof(RumSpriteRun)))
+            return;
+        run = &window->sprites.queue.runs[window->sprites.queue.run_count++];
+        run->image = image;
+        run->first = window->sprites.queue.count;
+        run->count = 0;
+    }
+    run->count++;
+
+    float width = (float)image->width;
+    float height = (float)image->height;
+    window->sprites.queue.instances[window->sprites.queue.count++] = (RumSpriteInstance){
+        (float)x, (float)y, (float)rect.width * scale, (float)rect.height * scale,
+        (float)rect.x / width, (float)rect.y / height,
+        (float)(rect.x + rect.width) / width, (float)(rect.y + rect.height) / height,
+    };
+}
+
+void rum_draw_image(RumImage* image, int32_t x, int32_t y) {
+    rum_draw_sprite(image, x, y, NULL, 1.0f);
+}
+
+// Uploads every queued sprite at once and draws each run of the same image with one instanced call
+static void draw_sprites(RumWindow* window, const RumSpriteQueue* queue) {
+    if(queue->count == 0)
+        return;
+
+    // Respecifying the whole store lets the driver hand out fresh memory while the last frame is still drawn
+    glBindBuffer(GL_ARRAY_BUFFER, window->sprites.instance_buffer);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(queue->count * sizeof(RumSpriteInstance)), queue->instances, GL_STREAM_DRAW);
+
+    glUseProgram(RUM.sprites.shader_program);
+    glBindVertexArray(window->sprites.vertex_array);
+    glUniform2f(RUM.sprites.screen_size_location, (float)window->image.width, (float)window->image.height);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    for(uint32_t i = 0; i < queue->run_count; ++i) {
+        const RumSpriteRun* run = &queue->runs[i];
+        if(!run->image)
+            continue;
+        // Base instances need GL 4.2, moving the instance pointers does the same on 3.3
+        uintptr_t offset = run->first * sizeof(RumSpriteInstance);
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(RumSpriteInstance), (const void*)offset);
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(RumSpriteInstance), (const void*)(offset + 4 * sizeof(float)));
+        glUniform1i(RUM.sprites.swizzle_location, (GLint)texture_formats[run->image->format].swizzle);
+        glBindTexture(GL_TEXTURE_2D, run->image->texture);
+        glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL, (GLsizei)run->count);
+        window->drawing.sprite_draw_calls++;
+    }
+    glDisable(GL_BLEND);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    window->drawing.sprites += queue->count;
+}
+
+// Copies a queue into one the present thread owns, reusing its arrays
+static bool copy_sprite_queue(RumSpriteQueue* dst, const RumSpriteQueue* src) {
+    if(dst->capacity < src->capacity) {
+        RumSpriteInstance* instances = realloc(dst->instances, src->capacity * sizeof(RumSpriteInstance));
+        if(!instances)
+            return false;
+        dst->instances = instances;
+        dst->capacity = src->capacity;
+    }
+    if(dst->run_capacity < src->run_capacity) {
+        RumSpriteRun* runs = realloc(dst->runs, src->run_capacity * sizeof(RumSpriteRun));
+        if(!runs)
+            return false;
+        dst->runs = runs;
+        dst->run_capacity = src->run_capacity;
+    }
+    memcpy(dst->instances, src->instances, src->count * sizeof(RumSpriteInstance));
+    memcpy(dst->runs, src->runs, src->run_count * sizeof(RumSpriteRun));
+    dst->count = src->count;
+    dst->run_count = src->run_count;
+    return true;
+}
+
+// Whether the queued sprites differ from the ones on screen
+static bool sprites_changed(RumWindow* window) {
+    const RumSpriteQueue* queue = &window->sprites.queue;
+    const RumSpriteQueue* drawn = &window->sprites.drawn;
+    return queue->count != drawn->count || queue->run_count != drawn->run_count
+        || memcmp(queue->runs, drawn->runs, queue->run_count * sizeof(RumSpriteRun)) != 0
+        || memcmp(queue->instances, drawn->instances, queue->count * sizeof(RumSpriteInstance)) != 0;
+}
+
+// The queue becomes the drawn one, the old drawn arrays are reused for the next frame
+static void retire_sprites(RumWindow* window) {
+    RumSpriteQueue drawn = window->sprites.drawn;
+    window->sprites.drawn = window->sprites.queue;
+    window->sprites.queue = drawn;
+    window->sprites.queue.count = 0;
+    window->sprites.queue.run_count = 0;
+}
+
+void rum_set_present_mode(RumPresentMode mode) {
+    RUM.present_mode = mode;
+    for(RumWindow* window = &RUM.window; window; window = window->next)
+        window->damaged = true;
+}
+
+void rum_set_vsync(bool enabled) {
+    lock_present();
+    RUM.pacing.vsync = enabled;
+    unlock_present();
+    // The present thread picks it up before its next swap
+    if(RUM.initialized && !RUM.headless.enabled && !RUM.software && !RUM.async.running)
+        glfwSwapInterval(enabled ? 1 : 0);
+}
+
+void rum_set_target_fps(double fps) {
+    lock_present();
+    RUM.pacing.target_period = fps > 0.0 ? 1.0 / fps : 0.0;
+    unlock_present();
+    RUM.pacing.deadline = 0.0;
+}
+
+void rum_set_max_frames_in_flight(uint32_t frames) {
+    lock_present();
+    RUM.in_flight.limit = frames < RUM_MAX_FRAMES_IN_FLIGHT ? frames : RUM_MAX_FRAMES_IN_FLIGHT;
+    unlock_present();
+}
+
+double rum_get_time() {
+    return glfwGetTime();
+}
+
+double rum_get_frame_delta() {
+    return RUM.pacing.frame_delta;
+}
+
+// Holds the frame until its deadline, sleeping while that is safe and spinning on the clock for the rest
+static void pace_frame() {
+    double now = glfwGetTime();
+    double period = RUM.pacing.target_period;
+    if(period > 0.0) {
+        // Deadlines follow each other so one late frame does not shift the rest, unless it is behind by a whole frame
+        RUM.pacing.deadline += period;
+        if(RUM.pacing.deadline < now - period || RUM.pacing.deadline > now + period)
+            RUM.pacing.deadline = now + period;
+        RUM_TRACE_BEGIN("rum_pace_frame");
+        if(RUM.pacing.deadline - now > RUM_PACING_SPIN_TIME)
+            _rum_sleep(RUM.pacing.deadline - now - RUM_PACING_SPIN_TIME);
+        while((now = glfwGetTime()) < RUM.pacing.deadline)
+            ;
+        RUM_TRACE_END();
+    }
+
+    if(RUM.pacing.frame_end > 0.0) {
+        RUM.pacing.frame_delta = now - RUM.pacing.frame_end;
+        if(period > 0.0) {
+            double error = RUM.pacing.frame_delta > period ? RUM.pacing.frame_delta - period : period - RUM.pacing.frame_delta;
+            RUM.window.stats.paced_frames++;
+            RUM.window.stats.pacing_error_total += error;
+            if(error > RUM.window.stats.pacing_error_max)
+                RUM.window.stats.pacing_error_max = error;
+        }
+    }
+    RUM.pacing.frame_end = now;
+}
+
+void rum_set_frame_stats_window(uint32_t frames) {
+    RumFrameTimes* samples = NULL;
+    if(frames > 0) {
+        samples = calloc(frames, sizeof(RumFrameTimes));
+        if(!samples)
+            return;
+    }
+    lock_present();
+    free(RUM.timing.samples);
+    RUM.timing.samples = samples;
+    RUM.timing.window = frames;
+    RUM.timing.next = 0;
+    RUM.timing.count = 0;
+    memset(&RUM.timing.current, 0, sizeof(RUM.timing.current));
+    atomic_store_explicit(&RUM.timing.copy_time, 0, memory_order_relaxed);
+    RUM.timing.frame_upload_bytes = RUM.window.stats.upload_bytes;
+    unlock_present();
+}
+
+// Starts timing the GPU work of this frame, and picks up the oldest query if the GPU has finished it
+static void begin_gpu_timing() {
+    if(!RUM.timing.queries_created) {
+        glGenQueries(RUM_GPU_QUERY_COUNT, RUM.timing.queries);
+        RUM.timing.queries_created = true;
+    }
+    uint32_t index = RUM.timing.query_next;
+    if(RUM.timing.query_pending[index]) {
+        GLuint available = 0;
+        glGetQueryObjectuiv(RUM.timing.queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+        if(!available) {
+            // Still busy after a full ring of frames, its result is dropped rather than waited for
+            RUM.timing.query_pending[index] = false;
+        } else {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(RUM.timing.queries[index], GL_QUERY_RESULT, &elapsed);
+            RUM.timing.gpu_time = (double)elapsed * 1e-9;
+        }
+    }
+    glBeginQuery(GL_TIME_ELAPSED, RUM.timing.queries[index]);
+}
+
+static void end_gpu_timing() {
+    glEndQuery(GL_TIME_ELAPSED);
+    RUM.timing.query_pending[RUM.timing.query_next] = true;
+    RUM.timing.query_next = (RUM.timing.query_next + 1) % RUM_GPU_QUERY_COUNT;
+}
+
+static void record_frame_times() {
+    RumFrameTimes* sample = &RUM.timing.current;
+    sample->copy = (double)atomic_exchange_explicit(&RUM.timing.copy_time, 0, memory_order_relaxed) * 1e-9;
+    sample->gpu = RUM.timing.gpu_time;
+    sample->frame = RUM.pacing.frame_delta;
+    sample->upload_bytes = (double)(RUM.window.stats.upload_bytes - RUM.timing.frame_upload_bytes);
+    RUM.timing.samples[RUM.timing.next] = *sample;
+    RUM.timing.next = (RUM.timing.next + 1) % RUM.timing.window;
+    if(RUM.timing.count < RUM.timing.window)
+        RUM.timing.count++;
+    memset(sample, 0, sizeof(*sample));
+    RUM.timing.frame_upload_bytes = RUM.window.stats.upload_bytes;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static bool summarize_frame_times(RumFrameStats* stats) {
+    if(!RUM.timing.window || RUM.timing.count == 0)
+        return false;
+
+    uint32_t count = RUM.timing.count;
+    stats->frame_count = count;
+    stats->last = RUM.timing.samples[(RUM.timing.next + RUM.timing.window - 1) % RUM.timing.window];
+
+    // Each field of RumFrameTimes is a double, they are summarized one column at a time
+    double* column = malloc(count * sizeof(double));
+    if(!column)
+        return false;
+    const uint32_t field_count = sizeof(RumFrameTimes) / sizeof(double);
+    for(uint32_t field = 0; field < field_count; ++field) {
+        double sum = 0.0;
+        for(uint32_t i = 0; i < count; ++i) {
+            column[i] = ((const double*)&RUM.timing.samples[i])[field];
+            sum += column[i];
+        }
+        qsort(column, count, sizeof(double), compare_double);
+        ((double*)&stats->min)[field] = column[0];
+        ((double*)&stats->avg)[field] = sum / (double)count;
+        ((double*)&stats->p99)[field] = column[(count * 99 + 99) / 100 - 1];
+    }
+    free(column);
+    return true;
+}
+
+bool rum_get_frame_stats(RumFrameStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    lock_present();
+    bool summarized = summarize_frame_times(stats);
+    unlock_present();
+    return summarized;
+}
+
+// 3x5 glyphs for the HUD text, one row of three bits per glyph line, top line first
+static const char hud_glyph_chars[] = " 0123456789.%/FPSMBDIRTY";
+static const uint8_t hud_glyphs[][5] = {
+    { 0, 0, 0, 0, 0 },
+    { 7, 5, 5, 5, 7 }, { 2, 6, 2, 2, 7 }, { 7, 1, 7, 4, 7 }, { 7, 1, 7, 1, 7 }, { 5, 5, 7, 1, 1 },
+    { 7, 4, 7, 1, 7 }, { 7, 4, 7, 5, 7 }, { 7, 1, 1, 1, 1 }, { 7, 5, 7, 5, 7 }, { 7, 5, 7, 1, 7 },
+    { 0, 0, 0, 0, 2 }, { 5, 1, 2, 4, 5 }, { 1, 1, 2, 4, 4 },
+    { 7, 4, 6, 4, 4 }, { 6, 5, 6, 4, 4 }, { 7, 4, 7, 1, 7 }, { 5, 7, 7, 5, 5 }, { 6, 5, 6, 5, 6 },
+    { 6, 5, 5, 5, 6 }, { 7, 2, 2, 2, 7 }, { 6, 5, 6, 5, 5 }, { 7, 2, 2, 2, 2 }, { 5, 5, 2, 2, 2 },
+};
+#define RUM_HUD_GLYPH_COUNT (sizeof(hud_glyphs) / sizeof(hud_glyphs[0]))
+// Glyphs sit 4 pixels apart in the font image, followed by a solid block used for the panel and the graph
+#define RUM_HUD_SOLID_X (RUM_HUD_GLYPH_COUNT * 4)
+#define RUM_HUD_FONT_WIDTH (RUM_HUD_SOLID_X + 2)
+#define RUM_HUD_SCALE 2
+#define RUM_HUD_PADDING 8
+#define RUM_HUD_GRAPH_HEIGHT 60
+#define RUM_HUD_LINE_HEIGHT (6 * RUM_HUD_SCALE)
+
+static RumImage* create_hud_font() {
+    uint8_t pixels[5][RUM_HUD_FONT_WIDTH][2];
+    memset(pixels, 0, sizeof(pixels));
+    for(uint32_t glyph = 0; glyph < RUM_HUD_GLYPH_COUNT; ++glyph) {
+        for(int line = 0; line < 5; ++line) {
+            for(int column = 0; column < 3; ++column) {
+                uint8_t value = (hud_glyphs[glyph][line] >> (2 - column)) & 1 ? 255 : 0;
+                // Image rows start at the bottom, glyph lines at the top
+                pixels[4 - line][glyph * 4 + column][0] = value;
+                pixels[4 - line][glyph * 4 + column][1] = value;
+            }
+        }
+    }
+    for(int y = 0; y < 5; ++y) {
+        for(uint32_t x = RUM_HUD_SOLID_X; x < RUM_HUD_FONT_WIDTH; ++x) {
+            pixels[y][x][0] = 255;
+            pixels[y][x][1] = 255;
+        }
+    }
+    RumImage* font = rum_create_image(RUM_RG8, &pixels[0][0][0], RUM_HUD_FONT_WIDTH, 5);
+    if(font) {
+        // Scaled pixel text has to stay sharp
+        glBindTexture(GL_TEXTURE_2D, font->texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (GLint)RUM_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, (GLint)RUM_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    return font;
+}
+
+void rum_set_hud(bool enabled) {
+    rum_window_set_hud(&RUM.window, enabled);
+}
+
+// The font is shared by every window and kept until rum_terminate, each window has its own instance buffer
+void rum_window_set_hud(RumWindow* window, bool enabled) {
+    if(!window)
+        return;
+    // Holding the context also keeps the present thread away from the HUD state
+    acquire_context();
+    if(enabled && RUM.initialized && !RUM.hud_font)
+        RUM.hud_font = create_hud_font();
+    enabled = enabled && RUM.hud_font;
+    if(enabled && !window->hud.enabled)
+        glGenBuffers(1, &window->hud.instance_buffer);
+    else if(!enabled && window->hud.enabled)
+        glDeleteBuffers(1, &window->hud.instance_buffer);
+    window->hud.enabled = enabled;
+    window->hud.next = 0;
+    window->hud.count = 0;
+    window->hud.refreshed = 0.0;
+    memset(window->hud.lines, 0, sizeof(window->hud.lines));
+    window->hud.frame_upload_bytes = window->stats.upload_bytes;
+    window->hud.frame_dirty_area = 0;
+    window->hud.frame_end = 0.0;
+    release_context();
+    window->damaged = true;
+}
+
+static void record_hud_frame(RumWindow* window, double frame_time) {
+    window->hud.frame_times[window->hud.next] = frame_time;
+    window->hud.upload_bytes[window->hud.next] = (double)(window->stats.upload_bytes - window->hud.frame_upload_bytes);
+    window->hud.dirty_area[window->hud.next] = (double)window->hud.frame_dirty_area;
+    window->hud.next = (window->hud.next + 1) % RUM_HUD_FRAMES;
+    if(window->hud.count < RUM_HUD_FRAMES)
+        window->hud.count++;
+    window->hud.frame_upload_bytes = window->stats.upload_bytes;
+    window->hud.frame_dirty_area = 0;
+
+    double now = glfwGetTime();
+    if(now - window->hud.refreshed < RUM_HUD_REFRESH)
+        return;
+    window->hud.refreshed = now;
+    double time = 0.0, bytes = 0.0, area = 0.0;
+    for(uint32_t i = 0; i < window->hud.count; ++i) {
+        time += window->hud.frame_times[i];
+        bytes += window->hud.upload_bytes[i];
+        area += window->hud.dirty_area[i];
+    }
+    double screen_area = (double)(window->image.width * window->image.height);
+    snprintf(window->hud.lines[0], sizeof(window->hud.lines[0]), "FPS %.1f", time > 0.0 ? window->hud.count / time : 0.0);
+    snprintf(window->hud.lines[1], sizeof(window->hud.lines[1]), "MS %.2f", time * 1000.0 / window->hud.count);
+    snprintf(window->hud.lines[2], sizeof(window->hud.lines[2]), "MB/S %.1f", time > 0.0 ? bytes / time / (1024.0 * 1024.0) : 0.0);
+    snprintf(window->hud.lines[3], sizeof(window->hud.lines[3]), "DIRTY %.0f%%", area * 100.0 / (screen_area * window->hud.count));
+    // Frames skipped by RUM_PRESENT_ON_CHANGE would otherwise never show the new numbers
+    window->damaged = true;
+}
+
+static uint32_t push_hud_rect(RumSpriteInstance* instances, uint32_t count, float source_x, float source_width, float x, float y, float width, float height) {
+    instances[count] = (RumSpriteInstance){ x, y, width, height,
+        source_x / RUM_HUD_FONT_WIDTH, 0.0f, (source_x + source_width) / RUM_HUD_FONT_WIDTH, 1.0f };
+    return count + 1;
+}
+
+static uint32_t push_hud_text(RumSpriteInstance* instances, uint32_t count, const char* text, float x, float y) {
+    for(; *text; ++text, x += 4 * RUM_HUD_SCALE) {
+        const char* found = strchr(hud_glyph_chars, *text);
+        if(!found || *text == ' ')
+            continue;
+        count = push_hud_rect(instances, count, (float)((found - hud_glyph_chars) * 4), 3.0f, x, y, 3.0f * RUM_HUD_SCALE, 5.0f * RUM_HUD_SCALE);
+    }
+    return count;
+}
+
+// A second pass over the finished frame, built from the font image through the sprite pipeline with a tint per group
+static void draw_hud(RumWindow* window) {
+    // Panel, graph bars split into good and slow frames, and four lines of text
+    RumSpriteInstance instances[1 + RUM_HUD_FRAMES + 4 * 16];
+    uint32_t group_end[4];
+    uint32_t count = 0;
+
+    float panel_width = RUM_HUD_FRAMES * 2 + 2 * RUM_HUD_PADDING;
+    float panel_height = RUM_HUD_GRAPH_HEIGHT + 4 * RUM_HUD_LINE_HEIGHT + 3 * RUM_HUD_PADDING;
+    float left = RUM_HUD_PADDING;
+    float bottom = (float)window->image.height - RUM_HUD_PADDING - panel_height;
+    count = push_hud_rect(instances, count, RUM_HUD_SOLID_X + 0.5f, 1.0f, left, bottom, panel_width, panel_height);
+    group_end[0] = count;
+
+    // Bars fill the graph at 33 ms, frames over 1.5 times the target (or 60 Hz) count as slow
+    double budget = RUM.pacing.target_period > 0.0 ? RUM.pacing.target_period : 1.0 / 60.0;
+    float graph_x = left + RUM_HUD_PADDING;
+    float graph_y = bottom + RUM_HUD_PADDING;
+    for(int pass = 0; pass < 2; ++pass) {
+        for(uint32_t i = 0; i < window->hud.count; ++i) {
+            // Oldest frame on the left
+            uint32_t index = (window->hud.next + RUM_HUD_FRAMES - window->hud.count + i) % RUM_HUD_FRAMES;
+            double frame_time = window->hud.frame_times[index];
+            if((frame_time > budget * 1.5) != (pass == 1))
+                continue;
+            float height = (float)(frame_time / 0.033 * RUM_HUD_GRAPH_HEIGHT);
+            if(height > RUM_HUD_GRAPH_HEIGHT)
+                height = RUM_HUD_GRAPH_HEIGHT;
+            float x = graph_x + (float)(RUM_HUD_FRAMES - window->hud.count + i) * 2.0f;
+            count = push_hud_rect(instances, count, RUM_HUD_SOLID_X + 0.5f, 1.0f, x, graph_y, 2.0f, height);
+        }
+        group_end[1 + pass] = count;
+    }
+
+    float text_y = graph_y + RUM_HUD_GRAPH_HEIGHT + RUM_HUD_PADDING;
+    for(int line = 3; line >= 0; --line, text_y += RUM_HUD_LINE_HEIGHT)
+        count = push_hud_text(instances, count, window->hud.lines[line], graph_x, text_y);
+    group_end[3] = count;
+
+    static const float tints[4][4] = {
+        { 0.0f, 0.0f, 0.0f, 0.6f },
+        { 0.3f, 0.9f, 0.3f, 1.0f },
+        { 0.95f, 0.25f, 0.2f, 1.0f },
+        { 1.0f, 1.0f, 1.0f, 1.0f },
+    };
+
+    glBindBuffer(GL_ARRAY_BUFFER, window->hud.instance_buffer);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(count * sizeof(RumSpriteInstance)), instances, GL_STREAM_DRAW);
+    glUseProgram(RUM.sprites.shader_program);
+    glBindVertexArray(window->sprites.vertex_array);
+    glUniform2f(RUM.sprites.screen_size_location, (float)window->image.width, (float)window->image.height);
+    glUniform1i(RUM.sprites.swizzle_location, (GLint)texture_formats[RUM_RG8].swizzle);
+    glBindTexture(GL_TEXTURE_2D, RUM.hud_font->texture);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    uint32_t first = 0;
+    for(int group = 0; group < 4; ++group) {
+        if(group_end[group] > first) {
+            uintptr_t offset = first * sizeof(RumSpriteInstance);
+            glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(RumSpriteInstance), (const void*)offset);
+            glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(RumSpriteInstance), (const void*)(offset + 4 * sizeof(float)));
+            glUniform4fv(RUM.sprites.tint_location, 1, tints[group]);
+            glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL, (GLsizei)(group_end[group] - first));
+        }
+        first = group_end[group];
+    }
+    glUniform4f(RUM.sprites.tint_location, 1.0f, 1.0f, 1.0f, 1.0f);
+    glDisable(GL_BLEND);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Skipped frames are counted but not sampled, their zero upload, draw and swap times would only drag the frame
+// stats of an idle screen down. Their copy time goes into the next drawn frame's sample. Pacing and frame stats follow
+// the default window, other windows time their HUD from one update to the next
+static void end_frame(RumWindow* window, bool presented) {
+    double frame_time = 0.0;
+    if(window == &RUM.window) {
+        pace_frame();
+        frame_time = RUM.pacing.frame_delta;
+    } else {
+        double now = glfwGetTime();
+        if(window->hud.frame_end > 0.0)
+            frame_time = now - window->hud.frame_end;
+        window->hud.frame_end = now;
+    }
+    lock_present();
+    if(window == &RUM.window && RUM.timing.window && presented)
+        record_frame_times();
+    if(window->hud.enabled)
+        record_hud_frame(window, frame_time);
+    window->stats.frames++;
+    unlock_present();
+    if(window == &RUM.window)
+        RUM.events.polled = false;
+}
+
+// Pushes only what changed since the last frame, the window system keeps the rest unless it reports damage
+static void present_software(const uint8_t* submitted, bool updated, bool damaged) {
+    RumWindow* window = &RUM.window;
+    double start = 0.0;
+    if(RUM.timing.window)
+        start = glfwGetTime();
+    RUM_TRACE_BEGIN("rum_present");
+    if(submitted) {
+        replace_staging_image(window, submitted);
+        updated = false;
+    }
+    const uint8_t* pixels = window->image.data;
+    RumRect screen = { 0, 0, (int64_t)window->image.width, (int64_t)window->image.height };
+    const RumRect* rects = window->dirty.rects;
+    uint32_t count = updated ? window->dirty.count : 0;
+    int64_t dirty_area = 0;
+    for(uint32_t i = 0; i < count; ++i)
+        dirty_area += rect_area(&rects[i]);
+    if(submitted || damaged || dirty_area * 100 >= rect_area(&screen) * RUM_DIRTY_FULL_UPLOAD_PERCENT) {
+        rects = &screen;
+        count = 1;
+        dirty_area = rect_area(&screen);
+    }
+    if(dirty_area > 0) {
+        _rum_software_present(RUM.software, window->image.format, pixels, rects, count);
+        window->stats.uploads++;
+        window->stats.upload_bytes += (uint64_t)dirty_area * window->image.pixel_size;
+    }
+    window->stats.frames_presented++;
+    RUM_TRACE_END();
+    if(RUM.timing.window) {
+        RUM.timing.current.upload = glfwGetTime() - start;
+        RUM.timing.current.draw = 0.0;
+        RUM.timing.current.swap = 0.0;
+    }
+    end_frame(window, true);
+}
+
+// Adds what the last frame uploaded and drew to the counters rum_get_stats reads
+static void add_drawing_stats(RumWindow* window) {
+    window->stats.uploads += window->drawing.uploads;
+    window->stats.upload_bytes += window->drawing.upload_bytes;
+    window->stats.upload_waits += window->drawing.upload_waits;
+    window->stats.upload_wait_time += window->drawing.upload_wait_time;
+    window->stats.sprites += window->drawing.sprites;
+    window->stats.sprite_draw_calls += window->drawing.sprite_draw_calls;
+    memset(&window->drawing, 0, sizeof(window->drawing));
+}
+
+// Shows the other windows drawn since the default window's last swap. Their swap interval is 0, so right after the
+// default window waited for vsync they swap without a wait of their own and follow its vsync
+static void swap_windows() {
+    for(RumWindow* window = RUM.window.next; window; window = window->next) {
+        if(!window->swap_pending)
+            continue;
+        window->swap_pending = false;
+        RUM_TRACE_BEGIN("rum_swap_window");
+        enter_window(window);
+        glfwSwapBuffers(window->glfw_window);
+        leave_window(window);
+        RUM_TRACE_END();
+    }
+}
+
+// Called when the default window skips its frame, under async present the present thread swaps them
+static void show_windows() {
+    if(!RUM.async.running) {
+        swap_windows();
+        return;
+    }
+    _rum_mutex_lock(&RUM.async.mutex);
+    RUM.async.swap_windows = true;
+    _rum_cond_broadcast(&RUM.async.wake);
+    _rum_mutex_unlock(&RUM.async.mutex);
+}
+
+// Uploads `rects` of a screen sized image and draws the frame with `sprites` over it, then swaps. `from_slot` takes
+// the pixels from the current upload slot instead. Runs on whichever thread holds the context, the present thread
+// calls it with the present lock held and it is dropped for the upload, the draw and the swap. The window's context
+// has to be current
+static void render_frame(RumWindow* window, const uint8_t* pixels, const RumRect* rects, uint32_t count, bool from_slot, const RumSpriteQueue* sprites) {
+    // rum_set_frame_stats_window may run while the present thread draws, a frame is timed as a whole or not at all
+    bool timed = window == &RUM.window && RUM.timing.window > 0;
+    double start = 0.0;
+    if(timed) {
+        start = glfwGetTime();
+        begin_gpu_timing();
+    }
+    RumRect screen = { 0, 0, (int64_t)window->image.width, (int64_t)window->image.height };
+    int64_t dirty_area = 0;
+    for(uint32_t i = 0; i < count; ++i)
+        dirty_area += rect_area(&rects[i]);
+    window->hud.frame_dirty_area += dirty_area;
+    unlock_present();
+
+    RUM_TRACE_BEGIN("rum_upload");
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, RUM.index_buffer);
-    glBindVertexArray(RUM.vertex_array);
+    glBindVertexArray(window->vertex_array);
     glUseProgram(RUM.shader_program);
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, RUM.image.texture);
-    if(RUM.image.updated) {
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, (GLsizei)RUM.image.width, (GLsizei)RUM.image.height, GL_RGBA, GL_UNSIGNED_BYTE, RUM.image.data);
-        RUM.image.updated = false;
+    glBindTexture(GL_TEXTURE_2D, window->image.texture);
+    if(from_slot) {
+        submit_upload_slot(window, rects, count);
+    } else if(count > 0) {
+        if(dirty_area * 100 >= rect_area(&screen) * RUM_DIRTY_FULL_UPLOAD_PERCENT) {
+            rects = &screen;
+            count = 1;
+        }
+        upload_from(window, pixels, rects, count);
     }
+    RUM_TRACE_END();
+
+    double uploaded = 0.0;
+    if(timed)
+        uploaded = glfwGetTime();
+    RUM_TRACE_BEGIN("rum_draw");
     glUniform1i(glGetUniformLocation(RUM.shader_program, "u_texture"), 0);
+    glUniform1i(glGetUniformLocation(RUM.shader_program, "u_swizzle"), (GLint)texture_formats[window->image.format].swizzle);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL);
-    glfwSwapBuffers(RUM.glfw_window);
-}
\ No newline at end of file
+    draw_sprites(window, sprites);
+    // The HUD reads what end_frame records on the main thread
+    lock_present();
+    if(window->hud.enabled)
+        draw_hud(window);
+    RUM_TRACE_END();
+
+    double drawn = 0.0;
+    if(timed) {
+        end_gpu_timing();
+        drawn = glfwGetTime();
+        RUM.timing.current.upload = uploaded - start;
+        RUM.timing.current.draw = drawn - uploaded;
+    }
+    // Swap intervals belong to the context, other windows keep theirs at 0
+    if(window == &RUM.window && RUM.async.running && RUM.async.vsync != RUM.pacing.vsync) {
+        RUM.async.vsync = RUM.pacing.vsync;
+        if(!RUM.headless.enabled)
+            glfwSwapInterval(RUM.async.vsync ? 1 : 0);
+    }
+    // The swap is the part that waits for the display, the main thread may publish the next frame meanwhile
+    bool queued = window == &RUM.window;
+    uint32_t limit = queued ? RUM.in_flight.limit : 0;
+    unlock_present();
+    if(queued) {
+        RUM_TRACE_BEGIN("rum_swap");
+        glfwSwapBuffers(window->glfw_window);
+        RUM_TRACE_END();
+    } else {
+        window->swap_pending = true;
+    }
+    double swapped = glfwGetTime();
+    if(queued)
+        swap_windows();
+    double waited = 0.0;
+    uint32_t depth = queued ? limit_frames_in_flight(limit, &waited) : 0;
+    lock_present();
+    if(timed) {
+        RUM.timing.current.swap = swapped - drawn;
+        RUM.timing.current.queue_depth = (double)depth;
+        RUM.timing.current.queue_wait = waited;
+    }
+    if(depth >= limit && limit > 0) {
+        window->stats.frame_waits++;
+        window->stats.frame_wait_time += waited;
+    }
+    if(depth > window->stats.frame_queue_depth_max)
+        window->stats.frame_queue_depth_max = depth;
+    add_drawing_stats(window);
+    window->stats.frames_presented++;
+}
+
+// Hands the frame to the present thread. The changed rects go into the published copy of the screen image, and when
+// the present thread has not taken the previous frame yet they are merged with that one's, so rum_update_screen never
+// waits for a draw or a swap
+static void publish_frame(RumWindow* window, const uint8_t* submitted, bool updated) {
+    RUM_TRACE_BEGIN("rum_publish");
+    _rum_mutex_lock(&RUM.async.mutex);
+    RumRect screen = { 0, 0, (int64_t)window->image.width, (int64_t)window->image.height };
+    RumPublishedFrame* frame = &window->published.frames[window->published.next];
+    RumPublishedFrame* other = &window->published.frames[window->published.next ^ 1];
+    if(submitted) {
+        replace_staging_image(window, submitted);
+        memcpy(frame->pixels, submitted, window->image.data_size);
+        frame->rects[0] = screen;
+        frame->count = 1;
+        frame->stale_count = 0;
+        other->stale[0] = screen;
+        other->stale_count = 1;
+    } else {
+        // What went into the other copy while the present thread drew this one catches up first
+        for(uint32_t i = 0; i < frame->stale_count; ++i)
+            copy_rect(window, frame->pixels, window->image.data, &frame->stale[i]);
+        frame->stale_count = 0;
+        for(uint32_t i = 0; updated && i < window->dirty.count; ++i) {
+            copy_rect(window, frame->pixels, window->image.data, &window->dirty.rects[i]);
+            add_rect(frame->rects, &frame->count, window->dirty.rects[i]);
+            add_rect(other->stale, &other->stale_count, window->dirty.rects[i]);
+        }
+    }
+    if(!copy_sprite_queue(&frame->sprites, &window->sprites.queue))
+        frame->sprites.count = frame->sprites.run_count = 0;
+    window->published.ready = true;
+    _rum_cond_broadcast(&RUM.async.wake);
+    _rum_mutex_unlock(&RUM.async.mutex);
+    RUM_TRACE_END();
+}
+
+// Draws the newest frame published for the window, called with the present lock held
+static void present_published_frame(RumWindow* window) {
+    // The main thread publishes into the other copy from now on, this one is only read until the next frame
+    RumPublishedFrame* frame = &window->published.frames[window->published.next];
+    window->published.next ^= 1;
+    window->published.ready = false;
+    uint32_t count = frame->count;
+    frame->count = 0;
+    enter_window(window);
+    render_frame(window, frame->pixels, frame->rects, count, false, &frame->sprites);
+    leave_window(window);
+}
+
+static void present_thread(void* user) {
+    (void)user;
+    glfwMakeContextCurrent(RUM.window.glfw_window);
+    _rum_mutex_lock(&RUM.async.mutex);
+    for(;;) {
+        // Published frames go first, so neither a context handoff nor rum_terminate loses one. Every window gets at
+        // most one frame per pass, a default window published faster than it swaps cannot starve the others. The
+        // other windows are drawn first and wait for the default window's frame, which swaps them right after its
+        // vsync, or for the main thread to report that frame skipped. Windows are only added or removed while the
+        // main thread holds the context, so the list stays put meanwhile
+        bool presented = false;
+        for(RumWindow* window = RUM.window.next; window; window = window->next) {
+            if(window->published.ready) {
+                present_published_frame(window);
+                presented = true;
+            }
+        }
+        if(RUM.window.published.ready) {
+            present_published_frame(&RUM.window);
+            presented = true;
+        }
+        if(RUM.async.swap_windows) {
+            RUM.async.swap_windows = false;
+            swap_windows();
+        }
+        if(presented) {
+            continue;
+        } else if(RUM.async.handoff) {
+            glfwMakeContextCurrent(NULL);
+            RUM.async.handed = true;
+            _rum_cond_broadcast(&RUM.async.idle);
+            // Released once the main thread clears `handed`, it may already want the context again by then
+            while(RUM.async.handed)
+                _rum_cond_wait(&RUM.async.wake, &RUM.async.mutex);
+            glfwMakeContextCurrent(RUM.window.glfw_window);
+        } else if(RUM.async.quit) {
+            break;
+        } else {
+            _rum_cond_wait(&RUM.async.wake, &RUM.async.mutex);
+        }
+    }
+    _rum_mutex_unlock(&RUM.async.mutex);
+    glfwMakeContextCurrent(NULL);
+}
+
+void rum_update_screen()
+{
+    rum_window_update(&RUM.window);
+}
+
+void rum_window_update(RumWindow* window)
+{
+    if(!window)
+        return;
+    bool damaged = window->damaged;
+    window->damaged = false;
+    const uint8_t* submitted = take_submitted_frame(window);
+    // Copies made while a frame is locked stay marked until it is unlocked
+    bool updated = !window->upload.locked && collect_dirty_rects(window);
+    if(updated) {
+        // They were all made after the last unlock, which cleared the tiles
+        window->upload.pending = false;
+    }
+    if(RUM.present_mode == RUM_PRESENT_ON_CHANGE && !damaged && !submitted && !window->upload.pending
+            && !updated && !sprites_changed(window)) {
+        // The window still shows exactly this frame, other windows drawn before it are shown anyway
+        window->sprites.queue.count = 0;
+        window->sprites.queue.run_count = 0;
+        window->stats.frames_skipped++;
+        if(window == &RUM.window && !RUM.software)
+            show_windows();
+        end_frame(window, false);
+        return;
+    }
+    if(RUM.software) {
+        present_software(submitted, updated, damaged);
+        return;
+    }
+    if(RUM.async.running) {
+        publish_frame(window, submitted, updated);
+        retire_sprites(window);
+        end_frame(window, true);
+        return;
+    }
+
+    RumRect screen = { 0, 0, (int64_t)window->image.width, (int64_t)window->image.height };
+    enter_window(window);
+    if(submitted) {
+        // Drawn on another thread after anything the main thread did this frame, so it wins
+        replace_staging_image(window, submitted);
+        render_frame(window, submitted, &screen, 1, false, &window->sprites.queue);
+    } else if(window->upload.pending) {
+        // The pixels are already in GL memory, the texture is filled straight from the buffer
+        window->upload.pending = false;
+        render_frame(window, NULL, &screen, 1, true, &window->sprites.queue);
+    } else {
+        render_frame(window, window->image.data, window->dirty.rects, updated ? window->dirty.count : 0, false, &window->sprites.queue);
+    }
+    leave_window(window);
+    retire_sprites(window);
+    end_frame(window, true);
+}
+
+RumWindow* rum_get_default_window() {
+    return &RUM.window;
+}
+
+RumWindow* rum_window_create(const char* title, int32_t width, int32_t height) {
+    if(!RUM.initialized || RUM.software || width <= 0 || height <= 0)
+        return NULL;
+    RumWindow* window = calloc(1, sizeof(RumWindow));
+    if(!window)
+        return NULL;
+    if(!create_window_screen(window, (uint64_t)width, (uint64_t)height)) {
+        destroy_window_screen(window);
+        free(window);
+        return NULL;
+    }
+
+    acquire_context();
+    // The hints rum_init left behind pick the same platform and context API, which sharing requires
+    window->glfw_window = glfwCreateWindow((int)width, (int)height, title, NULL, RUM.window.glfw_window);
+    bool created = window->glfw_window != NULL;
+    if(created) {
+        enter_window(window);
+        // Only the default window waits for vsync, one more wait per window would divide the frame rate. This
+        // one swaps right after it instead, see swap_windows
+        if(!RUM.headless.enabled)
+            glfwSwapInterval(0);
+        created = create_window_objects(window) && (!RUM.async.running || create_published_frames(window));
+        if(!created)
+            destroy_window_objects(window);
+        leave_window(window);
+    }
+    if(created) {
+        set_window_callbacks(window);
+        window->next = RUM.window.next;
+        RUM.window.next = window;
+    }
+    release_context();
+    if(!created) {
+        glfwDestroyWindow(window->glfw_window);
+        destroy_published_frames(window);
+        destroy_window_screen(window);
+        free(window);
+        return NULL;
+    }
+    return window;
+}
+
+void rum_window_destroy(RumWindow* window) {
+    if(!window || window == &RUM.window)
+        return;
+    RumWindow** link = &RUM.window.next;
+    while(*link && *link != window)
+        link = &(*link)->next;
+    if(!*link)
+        return;
+
+    // The present thread has drawn what was published for it once the context is handed over
+    acquire_context();
+    *link = window->next;
+    enter_window(window);
+    destroy_window_objects(window);
+    leave_window(window);
+    release_context();
+    glfwDestroyWindow(window->glfw_window);
+    destroy_published_frames(window);
+    destroy_window_screen(window);
+    free(window);
+}
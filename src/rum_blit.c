@@ -0,0 +1,469 @@
+/**************************************************************************************
+ *
+ *  MIT License
+ *
+ *  Copyright (c) 2023 Bagas J. Sitanggang
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ ************************************************************************************/
+#include "rum_internal.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <memory.h>
+
+#if defined(RUM_ARCH_X86)
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #else
+        #include <cpuid.h>
+    #endif
+#endif
+
+// Scalar kernels, these are the reference every SIMD kernel has to match byte for byte
+
+static void rgb_to_rgba_scalar(uint8_t* dst, const uint8_t* src, uint64_t count) {
+    for(uint64_t i = 0; i < count; ++i) {
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+        dst[3] = 255;
+        dst += 4;
+        src += 3;
+    }
+}
+
+static void rgba_to_rgba_scalar(uint8_t* dst, const uint8_t* src, uint64_t count) {
+    memcpy(dst, src, count * 4);
+}
+
+// Swapping red and blue turns RGBA into BGRA and back
+static void swap_rb_scalar(uint8_t* dst, const uint8_t* src, uint64_t count) {
+    for(uint64_t i = 0; i < count; ++i) {
+        uint8_t r = src[0];
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = r;
+        dst[3] = src[3];
+        dst += 4;
+        src += 4;
+    }
+}
+
+static void copy_1_scalar(uint8_t* dst, const uint8_t* src, uint64_t count) {
+    memcpy(dst, src, count);
+}
+
+static void copy_2_scalar(uint8_t* dst, const uint8_t* src, uint64_t count) {
+    memcpy(dst, src, count * 2);
+}
+
+static void copy_3_scalar(uint8_t* dst, const uint8_t* src, uint64_t count) {
+    memcpy(dst, src, count * 3);
+}
+
+static void copy_8_scalar(uint8_t* dst, const uint8_t* src, uint64_t count) {
+    memcpy(dst, src, count * 8);
+}
+
+#if defined(RUM_ARCH_X86)
+
+RUM_TARGET("sse2")
+static void rgba_to_rgba_stream_sse2(uint8_t* dst, const uint8_t* src, uint64_t count) {
+    // Non-temporal stores need 16-byte aligned targets, the pixels before that go through memcpy
+    uint64_t head = ((16 - ((uintptr_t)dst & 15)) & 15) / 4;
+    if(head > count || ((uintptr_t)dst & 3))
+        head = count;
+    rgba_to_rgba_scalar(dst, src, head);
+    uint64_t i = head;
+    for(; i + 4 <= count; i += 4) {
+        __m128i px = _mm_loadu_si128((const __m128i*)(src + i * 4));
+        _mm_stream_si128((__m128i*)(dst + i * 4), px);
+    }
+    _mm_sfence();
+    rgba_to_rgba_scalar(dst + i * 4, src + i * 4, count - i);
+}
+
+RUM_TARGET("ssse3")
+static void rgb_to_rgba_ssse3(uint8_t* dst, const uint8_t* src, uint64_t count) {
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+    uint64_t i = 0;
+    // 16 pixels are exactly 48 source bytes, so the loads never go past the span
+    for(; i + 16 <= count; i += 16) {
+        const uint8_t* s = src + i * 3;
+        uint8_t* d = dst + i * 4;
+        __m128i in0 = _mm_loadu_si128((const __m128i*)(s +  0));
+        __m128i in1 = _mm_loadu_si128((const __m128i*)(s + 16));
+        __m128i in2 = _mm_loadu_si128((const __m128i*)(s + 32));
+        __m128i px0 = in0;
+        __m128i px1 = _mm_alignr_epi8(in1, in0, 12);
+        __m128i px2 = _mm_alignr_epi8(in2, in1, 8);
+        __m128i px3 = _mm_srli_si128(in2, 4);
+        _mm_storeu_si128((__m128i*)(d +  0), _mm_or_si128(_mm_shuffle_epi8(px0, shuffle), alpha));
+        _mm_storeu_si128((__m128i*)(d + 16), _mm_or_si128(_mm_shuffle_epi8(px1, shuffle), alpha));
+        _mm_storeu_si128((__m128i*)(d + 32), _mm_or_si128(_mm_shuffle_epi8(px2, shuffle), alpha));
+        _mm_storeu_si128((__m128i*)(d + 48), _mm_or_si128(_mm_shuffle_epi8(px3, shuffle), alpha));
+    }
+    rgb_to_rgba_scalar(dst + i * 4, src + i * 3, count - i);
+}
+
+RUM_TARGET("ssse3")
+static void swap_rb_ssse3(uint8_t* dst, const uint8_t* src, uint64_t count) {
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    uint64_t i = 0;
+    for(; i + 4 <= count; i += 4) {
+        __m128i px = _mm_loadu_si128((const __m128i*)(src + i * 4));
+        _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_shuffle_epi8(px, shuffle));
+    }
+    swap_rb_scalar(dst + i * 4, src + i * 4, count - i);
+}
+
+RUM_TARGET("ssse3")
+static void rgb_to_rgba_stream_ssse3(uint8_t* dst, const uint8_t* src, uint64_t count) {
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+    uint64_t head = ((16 - ((uintptr_t)dst & 15)) & 15) / 4;
+    if(head > count || ((uintptr_t)dst & 3))
+        head = count;
+    rgb_to_rgba_scalar(dst, src, head);
+    uint64_t i = head;
+    for(; i + 16 <= count; i += 16) {
+        const uint8_t* s = src + i * 3;
+        uint8_t* d = dst + i * 4;
+        __m128i in0 = _mm_loadu_si128((const __m128i*)(s +  0));
+        __m128i in1 = _mm_loadu_si128((const __m128i*)(s + 16));
+        __m128i in2 = _mm_loadu_si128((const __m128i*)(s + 32));
+        __m128i px0 = in0;
+        __m128i px1 = _mm_alignr_epi8(in1, in0, 12);
+        __m128i px2 = _mm_alignr_epi8(in2, in1, 8);
+        __m128i px3 = _mm_srli_si128(in2, 4);
+        _mm_stream_si128((__m128i*)(d +  0), _mm_or_si128(_mm_shuffle_epi8(px0, shuffle), alpha));
+        _mm_stream_si128((__m128i*)(d + 16), _mm_or_si128(_mm_shuffle_epi8(px1, shuffle), alpha));
+        _mm_stream_si128((__m128i*)(d + 32), _mm_or_si128(_mm_shuffle_epi8(px2, shuffle), alpha));
+        _mm_stream_si128((__m128i*)(d + 48), _mm_or_si128(_mm_shuffle_epi8(px3, shuffle), alpha));
+    }
+    _mm_sfence();
+    rgb_to_rgba_scalar(dst + i * 4, src + i * 3, count - i);
+}
+
+RUM_TARGET("avx2")
+static void rgb_to_rgba_avx2(uint8_t* dst, const uint8_t* src, uint64_t count) {
+    const __m256i shuffle = _mm256_setr_epi8(
+            0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+            0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    // Spread the 24 bytes of 8 pixels so each 128-bit lane starts with 4 whole pixels
+    const __m256i spread = _mm256_setr_epi32(0, 1, 2, 2, 3, 4, 5, 5);
+    const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+    uint64_t i = 0;
+    // Each step loads 32 bytes but consumes 24, keep 8 bytes of slack before the span ends
+    for(; i + 11 <= count; i += 8) {
+        __m256i in = _mm256_loadu_si256((const __m256i*)(src + i * 3));
+        __m256i px = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(in, spread), shuffle);
+        _mm256_storeu_si256((__m256i*)(dst + i * 4), _mm256_or_si256(px, alpha));
+    }
+    rgb_to_rgba_ssse3(dst + i * 4, src + i * 3, count - i);
+}
+
+RUM_TARGET("avx2")
+static void swap_rb_avx2(uint8_t* dst, const uint8_t* src, uint64_t count) {
+    const __m256i shuffle = _mm256_setr_epi8(
+            2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+            2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    uint64_t i = 0;
+    for(; i + 8 <= count; i += 8) {
+        __m256i px = _mm256_loadu_si256((const __m256i*)(src + i * 4));
+        _mm256_storeu_si256((__m256i*)(dst + i * 4), _mm256_shuffle_epi8(px, shuffle));
+    }
+    swap_rb_ssse3(dst + i * 4, src + i * 4, count - i);
+}
+
+static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+#if defined(_MSC_VER)
+    __cpuidex((int*)regs, (int)leaf, (int)subleaf);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+RUM_TARGET("xsave")
+static uint64_t xgetbv0(void) {
+    return _xgetbv(0);
+}
+
+uint64_t _rum_get_llc_size(void) {
+    uint32_t regs[4];
+    cpuid(0, 0, regs);
+    uint32_t max_leaf = regs[0];
+    bool intel = regs[1] == 0x756e6547 && regs[3] == 0x49656e69 && regs[2] == 0x6c65746e;
+    bool amd = regs[1] == 0x68747541 && regs[3] == 0x69746e65 && regs[2] == 0x444d4163;
+
+    // Both vendors describe their caches with the same deterministic cache parameter layout
+    uint32_t leaf = 0;
+    if(intel && max_leaf >= 4) {
+        leaf = 4;
+    } else if(amd) {
+        cpuid(0x80000000, 0, regs);
+        if(regs[0] >= 0x8000001D)
+            leaf = 0x8000001D;
+    }
+
+    uint64_t llc_size = 0;
+    for(uint32_t i = 0; leaf != 0 && i < 16; ++i) {
+        cpuid(leaf, i, regs);
+        uint32_t type = regs[0] & 0x1F;
+        if(type == 0)
+            break;
+        if(type == 2) // Instruction cache
+            continue;
+        uint64_t ways = ((regs[1] >> 22) & 0x3FF) + 1;
+        uint64_t partitions = ((regs[1] >> 12) & 0x3FF) + 1;
+        uint64_t line_size = (regs[1] & 0xFFF) + 1;
+        uint64_t sets = (uint64_t)regs[2] + 1;
+        uint64_t size = ways * partitions * line_size * sets;
+        if(size > llc_size)
+            llc_size = size;
+    }
+    return llc_size ? llc_size : RUM_DEFAULT_LLC_SIZE;
+}
+
+RumCpuLevel _rum_detect_cpu_level(void) {
+    uint32_t regs[4];
+    cpuid(0, 0, regs);
+    uint32_t max_leaf = regs[0];
+    if(max_leaf < 1)
+        return RUM_CPU_SCALAR;
+
+    cpuid(1, 0, regs);
+    bool sse2 = (regs[3] >> 26) & 1;
+    bool ssse3 = (regs[2] >> 9) & 1;
+    bool osxsave = (regs[2] >> 27) & 1;
+    bool avx = (regs[2] >> 28) & 1;
+    if(!sse2)
+        return RUM_CPU_SCALAR;
+    if(!ssse3)
+        return RUM_CPU_SSE2;
+
+    // AVX2 also needs the OS to save the upper halves of the ymm registers
+    if(max_leaf >= 7 && osxsave && avx && (xgetbv0() & 0x6) == 0x6) {
+        cpuid(7, 0, regs);
+        if((regs[1] >> 5) & 1)
+            return RUM_CPU_AVX2;
+    }
+    return RUM_CPU_SSSE3;
+}
+
+#else
+
+uint64_t _rum_get_llc_size(void) {
+    return RUM_DEFAULT_LLC_SIZE;
+}
+
+RumCpuLevel _rum_detect_cpu_level(void) {
+    return RUM_CPU_SCALAR;
+}
+
+#endif // RUM_ARCH_X86
+
+static const RumBlitKernels blit_kernels[RUM_CPU_LEVEL_COUNT] = {
+    [RUM_CPU_SCALAR] = { "scalar", rgb_to_rgba_scalar, rgba_to_rgba_scalar, rgb_to_rgba_scalar,       rgba_to_rgba_scalar,      swap_rb_scalar },
+#if defined(RUM_ARCH_X86)
+    [RUM_CPU_SSE2]   = { "sse2",   rgb_to_rgba_scalar, rgba_to_rgba_scalar, rgb_to_rgba_scalar,       rgba_to_rgba_stream_sse2, swap_rb_scalar },
+    [RUM_CPU_SSSE3]  = { "ssse3",  rgb_to_rgba_ssse3,  rgba_to_rgba_scalar, rgb_to_rgba_stream_ssse3, rgba_to_rgba_stream_sse2, swap_rb_ssse3 },
+    [RUM_CPU_AVX2]   = { "avx2",   rgb_to_rgba_avx2,   rgba_to_rgba_scalar, rgb_to_rgba_stream_ssse3, rgba_to_rgba_stream_sse2, swap_rb_avx2 },
+#endif
+};
+
+const RumBlitKernels* _rum_get_blit_kernels(RumCpuLevel level) {
+    if(level >= RUM_CPU_LEVEL_COUNT)
+        level = RUM_CPU_LEVEL_COUNT - 1;
+    while(level > RUM_CPU_SCALAR && blit_kernels[level].name == NULL)
+        level--;
+    return &blit_kernels[level];
+}
+
+uint32_t _rum_get_format_size(RumImageFormat format) {
+    switch(format) {
+        case RUM_R8:      return 1;
+        case RUM_RG8:     return 2;
+        case RUM_RGB:     return 3;
+        case RUM_RGBA:    return 4;
+        case RUM_BGRA:    return 4;
+        case RUM_RGB565:  return 2;
+        case RUM_RGBA16F: return 8;
+    }
+    return 0;
+}
+
+RumRowKernel _rum_get_row_kernel(const RumBlitKernels* kernels, RumImageFormat dst_format, RumImageFormat src_format, bool stream) {
+    if(dst_format == src_format) {
+        switch(_rum_get_format_size(dst_format)) {
+            case 1: return copy_1_scalar;
+            case 2: return copy_2_scalar;
+            case 3: return copy_3_scalar;
+            case 4: return stream ? kernels->rgba_to_rgba_stream : kernels->rgba_to_rgba;
+            case 8: return copy_8_scalar;
+            default: return NULL;
+        }
+    }
+    if(src_format == RUM_RGB && dst_format == RUM_RGBA)
+        return stream ? kernels->rgb_to_rgba_stream : kernels->rgb_to_rgba;
+    if((src_format == RUM_RGBA && dst_format == RUM_BGRA) || (src_format == RUM_BGRA && dst_format == RUM_RGBA))
+        return kernels->swap_rb;
+    return NULL;
+}
+
+// Half floats only ever hold values in [0, 1] here, so denormals are flushed and infinities clamped
+static uint16_t float_to_half(float value) {
+    union { float f; uint32_t u; } bits = { value };
+    uint32_t sign = (bits.u >> 16) & 0x8000;
+    int32_t exponent = (int32_t)((bits.u >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits.u & 0x7FFFFF;
+    if(exponent <= 0)
+        return (uint16_t)sign;
+    if(exponent >= 31)
+        return (uint16_t)(sign | 0x7C00);
+    // Round to nearest, a carry out of the mantissa correctly bumps the exponent
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    if(mantissa & 0x1000)
+        half++;
+    return (uint16_t)half;
+}
+
+static float half_to_float(uint16_t half) {
+    uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1F;
+    uint32_t mantissa = half & 0x3FF;
+    union { uint32_t u; float f; } bits;
+    if(exponent == 0) {
+        bits.u = sign;
+    } else if(exponent == 31) {
+        bits.u = sign | 0x7F800000 | (mantissa << 13);
+    } else {
+        bits.u = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+    return bits.f;
+}
+
+static uint8_t unorm_from_float(float value) {
+    if(!(value > 0.0f))
+        return 0;
+    if(value >= 1.0f)
+        return 255;
+    return (uint8_t)(value * 255.0f + 0.5f);
+}
+
+// Rec. 601 luma in 8.8 fixed point
+static uint8_t luma(const uint8_t* rgba) {
+    return (uint8_t)((77 * rgba[0] + 150 * rgba[1] + 29 * rgba[2] + 128) >> 8);
+}
+
+static void decode_row(uint8_t* rgba, const uint8_t* src, RumImageFormat format, uint64_t count) {
+    for(uint64_t i = 0; i < count; ++i, rgba += 4) {
+        switch(format) {
+            case RUM_R8:
+                rgba[0] = rgba[1] = rgba[2] = src[i];
+                rgba[3] = 255;
+                break;
+            case RUM_RG8:
+                rgba[0] = rgba[1] = rgba[2] = src[i * 2];
+                rgba[3] = src[i * 2 + 1];
+                break;
+            case RUM_RGB:
+                memcpy(rgba, src + i * 3, 3);
+                rgba[3] = 255;
+                break;
+            case RUM_RGBA:
+                memcpy(rgba, src + i * 4, 4);
+                break;
+            case RUM_BGRA:
+                swap_rb_scalar(rgba, src + i * 4, 1);
+                break;
+            case RUM_RGB565: {
+                uint16_t px;
+                memcpy(&px, src + i * 2, 2);
+                uint8_t r = (px >> 11) & 0x1F, g = (px >> 5) & 0x3F, b = px & 0x1F;
+                rgba[0] = (uint8_t)((r << 3) | (r >> 2));
+                rgba[1] = (uint8_t)((g << 2) | (g >> 4));
+                rgba[2] = (uint8_t)((b << 3) | (b >> 2));
+                rgba[3] = 255;
+                break;
+            }
+            case RUM_RGBA16F: {
+                uint16_t px[4];
+                memcpy(px, src + i * 8, 8);
+                for(int c = 0; c < 4; ++c)
+                    rgba[c] = unorm_from_float(half_to_float(px[c]));
+                break;
+            }
+        }
+    }
+}
+
+static void encode_row(uint8_t* dst, const uint8_t* rgba, RumImageFormat format, uint64_t count) {
+    for(uint64_t i = 0; i < count; ++i, rgba += 4) {
+        switch(format) {
+            case RUM_R8:
+                dst[i] = luma(rgba);
+                break;
+            case RUM_RG8:
+                dst[i * 2] = luma(rgba);
+                dst[i * 2 + 1] = rgba[3];
+                break;
+            case RUM_RGB:
+                memcpy(dst + i * 3, rgba, 3);
+                break;
+            case RUM_RGBA:
+                memcpy(dst + i * 4, rgba, 4);
+                break;
+            case RUM_BGRA:
+                swap_rb_scalar(dst + i * 4, rgba, 1);
+                break;
+            case RUM_RGB565: {
+                uint16_t px = (uint16_t)(((rgba[0] >> 3) << 11) | ((rgba[1] >> 2) << 5) | (rgba[2] >> 3));
+                memcpy(dst + i * 2, &px, 2);
+                break;
+            }
+            case RUM_RGBA16F: {
+                uint16_t px[4];
+                for(int c = 0; c < 4; ++c)
+                    px[c] = float_to_half(rgba[c] / 255.0f);
+                memcpy(dst + i * 8, px, 8);
+                break;
+            }
+        }
+    }
+}
+
+void _rum_convert_row(uint8_t* dst, RumImageFormat dst_format, const uint8_t* src, RumImageFormat src_format, uint64_t count) {
+    uint8_t rgba[256 * 4];
+    uint32_t dst_size = _rum_get_format_size(dst_format);
+    uint32_t src_size = _rum_get_format_size(src_format);
+    while(count > 0) {
+        uint64_t chunk = count < 256 ? count : 256;
+        decode_row(rgba, src, src_format, chunk);
+        encode_row(dst, rgba, dst_format, chunk);
+        dst += chunk * dst_size;
+        src += chunk * src_size;
+        count -= chunk;
+    }
+}
@@ -0,0 +1,166 @@
+/**************************************************************************************
+ *
+ *  MIT License
+ *
+ *  Copyright (c) 2023 Bagas J. Sitanggang
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ ************************************************************************************/
+
+#ifndef RUM_INTERNAL_H_
+#define RUM_INTERNAL_H_
+
+#include "rum.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if !defined(_WIN32)
+    #include <pthread.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define RUM_ARCH_X86
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    #define RUM_TARGET(isa)
+#else
+    #define RUM_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+/** Converts `count` pixels from `src` into `dst`, one row span at a time */
+typedef void (*RumRowKernel)(uint8_t* dst, const uint8_t* src, uint64_t count);
+
+typedef enum {
+    RUM_CPU_SCALAR = 0,
+    RUM_CPU_SSE2,
+    RUM_CPU_SSSE3,
+    RUM_CPU_AVX2,
+    RUM_CPU_LEVEL_COUNT,
+} RumCpuLevel;
+
+/** Used when the last level cache size cannot be queried */
+#define RUM_DEFAULT_LLC_SIZE (8ull * 1024 * 1024)
+
+typedef struct {
+    const char* name;
+    RumRowKernel rgb_to_rgba;
+    RumRowKernel rgba_to_rgba;
+    /** Same output, but written with non-temporal stores that bypass the cache */
+    RumRowKernel rgb_to_rgba_stream;
+    RumRowKernel rgba_to_rgba_stream;
+    /** RGBA to BGRA, which is the same as BGRA to RGBA */
+    RumRowKernel swap_rb;
+} RumBlitKernels;
+
+/** Highest instruction set level supported by both the CPU and the OS */
+RumCpuLevel _rum_detect_cpu_level(void);
+
+/** Size in bytes of the largest data cache, copies bigger than this are streamed */
+uint64_t _rum_get_llc_size(void);
+
+/** Kernel table for a level, the scalar table is the reference for every other one */
+const RumBlitKernels* _rum_get_blit_kernels(RumCpuLevel level);
+
+/** Size in bytes of one pixel, 0 for values outside RumImageFormat */
+uint32_t _rum_get_format_size(RumImageFormat format);
+
+/** Kernel for pairs of formats with a direct path, NULL when the pair has to go through _rum_convert_row */
+RumRowKernel _rum_get_row_kernel(const RumBlitKernels* kernels, RumImageFormat dst_format, RumImageFormat src_format, bool stream);
+
+/** Converts between any two formats by way of RGBA */
+void _rum_convert_row(uint8_t* dst, RumImageFormat dst_format, const uint8_t* src, RumImageFormat src_format, uint64_t count);
+
+#if defined(_WIN32)
+// SRWLOCK, CONDITION_VARIABLE and HANDLE are all pointer sized, windows.h stays out of here
+typedef struct { void* handle; } RumMutex;
+typedef struct { void* handle; } RumCond;
+typedef struct { void* handle; } RumThread;
+#else
+typedef struct { pthread_mutex_t handle; } RumMutex;
+typedef struct { pthread_cond_t handle; } RumCond;
+typedef struct { pthread_t handle; } RumThread;
+#endif
+
+typedef void (*RumThreadFunc)(void* user);
+
+bool _rum_thread_create(RumThread* thread, RumThreadFunc func, void* user);
+void _rum_thread_join(RumThread* thread);
+
+void _rum_mutex_init(RumMutex* mutex);
+void _rum_mutex_destroy(RumMutex* mutex);
+void _rum_mutex_lock(RumMutex* mutex);
+void _rum_mutex_unlock(RumMutex* mutex);
+
+void _rum_cond_init(RumCond* cond);
+void _rum_cond_destroy(RumCond* cond);
+void _rum_cond_wait(RumCond* cond, RumMutex* mutex);
+void _rum_cond_broadcast(RumCond* cond);
+
+/** Sleeps at least `seconds`, restarting after signals */
+void _rum_sleep(double seconds);
+
+#if !defined(RUM_NO_TRACE)
+    #include <stdatomic.h>
+
+    extern atomic_bool _rum_tracing;
+
+    /** Appends one event to the trace ring, `phase` is the Chrome trace 'B' or 'E' */
+    void _rum_trace_push(const char* name, char phase);
+
+    // Zones around rum's own phases, a relaxed load and a branch while tracing is off
+    #define RUM_TRACE_BEGIN(name) do { if(atomic_load_explicit(&_rum_tracing, memory_order_relaxed)) _rum_trace_push(name, 'B'); } while(0)
+    #define RUM_TRACE_END() do { if(atomic_load_explicit(&_rum_tracing, memory_order_relaxed)) _rum_trace_push(NULL, 'E'); } while(0)
+#else
+    #define RUM_TRACE_BEGIN(name) do {} while(0)
+    #define RUM_TRACE_END() do {} while(0)
+#endif
+
+// GLFW stays out of here like windows.h, the window is only passed through
+struct GLFWwindow;
+
+/** Screen presented without OpenGL, into an X11 or Win32 window or into memory */
+typedef struct RumSoftwareTarget RumSoftwareTarget;
+
+/** `window` must have no client API, a NULL window keeps every frame in memory for _rum_software_read */
+RumSoftwareTarget* _rum_software_create(struct GLFWwindow* window, const RumBlitKernels* kernels, uint64_t width, uint64_t height);
+void _rum_software_destroy(RumSoftwareTarget* target);
+
+/** Converts the `rects` of a screen sized image (row 0 at the bottom) and shows them */
+void _rum_software_present(RumSoftwareTarget* target, RumImageFormat format, const uint8_t* pixels, const RumRect* rects, uint32_t count);
+
+/** Last presented frame as RGBA with row 0 at the bottom, only memory targets can be read */
+bool _rum_software_read(const RumSoftwareTarget* target, uint8_t* pixels);
+
+/** Runs `job(user, index)` for every index below `job_count` */
+typedef void (*RumJobFunc)(void* user, uint32_t index);
+
+typedef struct RumWorkerPool RumWorkerPool;
+
+RumWorkerPool* _rum_pool_create(uint32_t worker_count);
+void _rum_pool_destroy(RumWorkerPool* pool);
+uint32_t _rum_pool_get_worker_count(const RumWorkerPool* pool);
+
+/** Spreads the jobs over the workers and the calling thread, returns once all of them are done.
+ * Safe to call from several threads, while one of them has the workers the others run their jobs themselves */
+void _rum_pool_run(RumWorkerPool* pool, RumJobFunc job, void* user, uint32_t job_count);
+
+#endif // RUM_INTERNAL_H_
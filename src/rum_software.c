@@ -0,0 +1,319 @@
+/**************************************************************************************
+ *
+ *  MIT License
+ *
+ *  Copyright (c) 2023 Bagas J. Sitanggang
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ ************************************************************************************/
+#include "rum_internal.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <GLFW/glfw3.h>
+
+#if defined(_GLFW_X11)
+    #include <X11/Xlib.h>
+    #include <X11/Xutil.h>
+    // glfw3native.h would pull in Xrandr.h for these two, which rum itself has no use for
+    GLFWAPI Display* glfwGetX11Display(void);
+    GLFWAPI Window glfwGetX11Window(GLFWwindow* window);
+    // Without libXext, `premake5 --no-xshm`, every frame goes through XPutImage
+    #if !defined(RUM_NO_XSHM)
+        #include <X11/extensions/XShm.h>
+        #include <sys/ipc.h>
+        #include <sys/shm.h>
+    #endif
+#elif defined(_GLFW_WIN32)
+    #define GLFW_EXPOSE_NATIVE_WIN32
+    #include <GLFW/glfw3native.h>
+#endif
+
+struct RumSoftwareTarget {
+    const RumBlitKernels* kernels;
+    uint64_t width, height;
+    // What the window system takes, BGRX for windows and RGBA for the memory sink
+    RumImageFormat format;
+    uint8_t* pixels;
+    uint64_t pitch;
+    // X11 images start at the top, DIBs and the memory sink at the bottom like the screen image
+    bool top_down;
+    bool windowed;
+
+#if defined(_GLFW_X11)
+    Display* display;
+    Window window;
+    GC gc;
+    XImage* image;
+#if !defined(RUM_NO_XSHM)
+    XShmSegmentInfo shm;
+#endif
+    bool use_shm;
+#elif defined(_GLFW_WIN32)
+    HWND window;
+    BITMAPINFO info;
+#endif
+};
+
+#if defined(_GLFW_X11)
+
+#if !defined(RUM_NO_XSHM)
+static bool shm_failed;
+
+static int shm_error_handler(Display* display, XErrorEvent* event) {
+    (void)display; (void)event;
+    shm_failed = true;
+    return 0;
+}
+
+// Shared memory only works with a local server, XShmAttach fails asynchronously on a remote one
+static bool create_shm_image(RumSoftwareTarget* target, Visual* visual, int depth) {
+    if(!XShmQueryExtension(target->display))
+        return false;
+    target->image = XShmCreateImage(target->display, visual, (unsigned int)depth, ZPixmap, NULL, &target->shm,
+            (unsigned int)target->width, (unsigned int)target->height);
+    if(!target->image)
+        return false;
+    target->shm.shmid = shmget(IPC_PRIVATE, (size_t)target->image->bytes_per_line * target->image->height, IPC_CREAT | 0600);
+    if(target->shm.shmid < 0) {
+        XDestroyImage(target->image);
+        target->image = NULL;
+        return false;
+    }
+    target->shm.shmaddr = target->image->data = shmat(target->shm.shmid, NULL, 0);
+    target->shm.readOnly = False;
+
+    shm_failed = false;
+    XErrorHandler previous = XSetErrorHandler(shm_error_handler);
+    bool attached = XShmAttach(target->display, &target->shm);
+    XSync(target->display, False);
+    XSetErrorHandler(previous);
+    // The segment goes away once both sides have detached from it
+    shmctl(target->shm.shmid, IPC_RMID, NULL);
+    if(!attached || shm_failed) {
+        shmdt(target->shm.shmaddr);
+        target->image->data = NULL;
+        XDestroyImage(target->image);
+        target->image = NULL;
+        return false;
+    }
+    return true;
+}
+#else
+static bool create_shm_image(RumSoftwareTarget* target, Visual* visual, int depth) {
+    (void)target; (void)visual; (void)depth;
+    return false;
+}
+#endif
+
+static void destroy_window_target(RumSoftwareTarget* target) {
+    if(target->gc)
+        XFreeGC(target->display, target->gc);
+    if(!target->image)
+        return;
+#if !defined(RUM_NO_XSHM)
+    if(target->use_shm) {
+        XShmDetach(target->display, &target->shm);
+        XSync(target->display, False);
+        shmdt(target->shm.shmaddr);
+        target->image->data = NULL;
+    }
+#endif
+    XDestroyImage(target->image);
+}
+
+static bool create_window_target(RumSoftwareTarget* target, GLFWwindow* window) {
+    if(glfwGetPlatform() != GLFW_PLATFORM_X11)
+        return false;
+    target->display = glfwGetX11Display();
+    target->window = glfwGetX11Window(window);
+    XWindowAttributes attributes;
+    if(!XGetWindowAttributes(target->display, target->window, &attributes))
+        return false;
+    // Only the common 24 bit TrueColor layout is handled, anything else needs a per-channel shift
+    Visual* visual = attributes.visual;
+    if(attributes.depth < 24 || visual->red_mask != 0xff0000 || visual->green_mask != 0xff00 || visual->blue_mask != 0xff)
+        return false;
+
+    target->use_shm = create_shm_image(target, visual, attributes.depth);
+    if(!target->use_shm) {
+        char* data = malloc(target->width * target->height * 4);
+        if(!data)
+            return false;
+        target->image = XCreateImage(target->display, visual, (unsigned int)attributes.depth, ZPixmap, 0, data,
+                (unsigned int)target->width, (unsigned int)target->height, 32, 0);
+        if(!target->image) {
+            free(data);
+            return false;
+        }
+    }
+    if(target->image->bits_per_pixel != 32 || target->image->byte_order != LSBFirst) {
+        destroy_window_target(target);
+        return false;
+    }
+
+    target->gc = XCreateGC(target->display, target->window, 0, NULL);
+    target->format = RUM_BGRA;
+    target->pixels = (uint8_t*)target->image->data;
+    target->pitch = (uint64_t)target->image->bytes_per_line;
+    target->top_down = true;
+    return true;
+}
+
+static void put_rects(RumSoftwareTarget* target, const RumRect* rects, uint32_t count) {
+    for(uint32_t i = 0; i < count; ++i) {
+        const RumRect* rect = &rects[i];
+        int y = (int)(target->height - rect->y - rect->height);
+#if !defined(RUM_NO_XSHM)
+        if(target->use_shm)
+            XShmPutImage(target->display, target->window, target->gc, target->image, (int)rect->x, y, (int)rect->x, y,
+                    (unsigned int)rect->width, (unsigned int)rect->height, False);
+        else
+#endif
+            XPutImage(target->display, target->window, target->gc, target->image, (int)rect->x, y, (int)rect->x, y,
+                    (unsigned int)rect->width, (unsigned int)rect->height);
+    }
+    // The server reads a shared image after the call returns, it must be done before the next frame is written
+    if(target->use_shm)
+        XSync(target->display, False);
+    else
+        XFlush(target->display);
+}
+
+#elif defined(_GLFW_WIN32)
+
+static bool create_window_target(RumSoftwareTarget* target, GLFWwindow* window) {
+    if(glfwGetPlatform() != GLFW_PLATFORM_WIN32)
+        return false;
+    target->window = glfwGetWin32Window(window);
+    target->pitch = target->width * 4;
+    target->pixels = malloc(target->pitch * target->height);
+    if(!target->pixels)
+        return false;
+    // A positive height makes the DIB bottom-up, the same row order as the screen image
+    target->info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    target->info.bmiHeader.biWidth = (LONG)target->width;
+    target->info.bmiHeader.biHeight = (LONG)target->height;
+    target->info.bmiHeader.biPlanes = 1;
+    target->info.bmiHeader.biBitCount = 32;
+    target->info.bmiHeader.biCompression = BI_RGB;
+    target->format = RUM_BGRA;
+    return true;
+}
+
+static void put_rects(RumSoftwareTarget* target, const RumRect* rects, uint32_t count) {
+    HDC dc = GetDC(target->window);
+    for(uint32_t i = 0; i < count; ++i) {
+        const RumRect* rect = &rects[i];
+        // Source coordinates of a bottom-up DIB count from its lower left corner
+        SetDIBitsToDevice(dc, (int)rect->x, (int)(target->height - rect->y - rect->height), (DWORD)rect->width, (DWORD)rect->height,
+                (int)rect->x, (int)rect->y, 0, (UINT)target->height, target->pixels, &target->info, DIB_RGB_COLORS);
+    }
+    ReleaseDC(target->window, dc);
+}
+
+static void destroy_window_target(RumSoftwareTarget* target) {
+    free(target->pixels);
+}
+
+#else
+
+static bool create_window_target(RumSoftwareTarget* target, GLFWwindow* window) {
+    (void)target; (void)window;
+    return false;
+}
+
+static void put_rects(RumSoftwareTarget* target, const RumRect* rects, uint32_t count) {
+    (void)target; (void)rects; (void)count;
+}
+
+static void destroy_window_target(RumSoftwareTarget* target) {
+    (void)target;
+}
+
+#endif
+
+RumSoftwareTarget* _rum_software_create(GLFWwindow* window, const RumBlitKernels* kernels, uint64_t width, uint64_t height) {
+    RumSoftwareTarget* target = calloc(1, sizeof(RumSoftwareTarget));
+    if(!target)
+        return NULL;
+    target->kernels = kernels;
+    target->width = width;
+    target->height = height;
+
+    if(window) {
+        if(!create_window_target(target, window)) {
+            free(target);
+            return NULL;
+        }
+        target->windowed = true;
+        return target;
+    }
+
+    target->format = RUM_RGBA;
+    target->pitch = width * 4;
+    target->pixels = calloc(1, target->pitch * height);
+    if(!target->pixels) {
+        free(target);
+        return NULL;
+    }
+    return target;
+}
+
+void _rum_software_destroy(RumSoftwareTarget* target) {
+    if(!target)
+        return;
+    if(target->windowed)
+        destroy_window_target(target);
+    else
+        free(target->pixels);
+    free(target);
+}
+
+void _rum_software_present(RumSoftwareTarget* target, RumImageFormat format, const uint8_t* pixels, const RumRect* rects, uint32_t count) {
+    uint64_t pixel_size = _rum_get_format_size(format);
+    uint64_t src_pitch = target->width * pixel_size;
+    RumRowKernel convert = _rum_get_row_kernel(target->kernels, target->format, format, false);
+    for(uint32_t i = 0; i < count; ++i) {
+        const RumRect* rect = &rects[i];
+        for(int64_t row = rect->y; row < rect->y + rect->height; ++row) {
+            uint64_t dst_row = target->top_down ? target->height - 1 - (uint64_t)row : (uint64_t)row;
+            uint8_t* dst = target->pixels + dst_row * target->pitch + (uint64_t)rect->x * 4;
+            const uint8_t* src = pixels + (uint64_t)row * src_pitch + (uint64_t)rect->x * pixel_size;
+            if(convert)
+                convert(dst, src, (uint64_t)rect->width);
+            else
+                _rum_convert_row(dst, target->format, src, format, (uint64_t)rect->width);
+        }
+    }
+    if(target->windowed)
+        put_rects(target, rects, count);
+}
+
+bool _rum_software_read(const RumSoftwareTarget* target, uint8_t* pixels) {
+    if(target->windowed)
+        return false;
+    memcpy(pixels, target->pixels, target->pitch * target->height);
+    return true;
+}
@@ -0,0 +1,298 @@
+/**************************************************************************************
+ *
+ *  MIT License
+ *
+ *  Copyright (c) 2023 Bagas J. Sitanggang
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ ************************************************************************************/
+// nanosleep is POSIX, strict C11 builds only declare it when asked to
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+    #define _POSIX_C_SOURCE 199309L
+#endif
+
+#include "rum_internal.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+#if defined(_WIN32)
+
+typedef struct {
+    RumThreadFunc func;
+    void* user;
+} ThreadStart;
+
+static DWORD WINAPI thread_start(LPVOID param) {
+    ThreadStart start = *(ThreadStart*)param;
+    free(param);
+    start.func(start.user);
+    return 0;
+}
+
+bool _rum_thread_create(RumThread* thread, RumThreadFunc func, void* user) {
+    ThreadStart* start = malloc(sizeof(ThreadStart));
+    if(!start)
+        return false;
+    start->func = func;
+    start->user = user;
+    thread->handle = CreateThread(NULL, 0, thread_start, start, 0, NULL);
+    if(!thread->handle) {
+        free(start);
+        return false;
+    }
+    return true;
+}
+
+void _rum_thread_join(RumThread* thread) {
+    WaitForSingleObject((HANDLE)thread->handle, INFINITE);
+    CloseHandle((HANDLE)thread->handle);
+}
+
+void _rum_mutex_init(RumMutex* mutex) { InitializeSRWLock((PSRWLOCK)&mutex->handle); }
+void _rum_mutex_destroy(RumMutex* mutex) { (void)mutex; }
+void _rum_mutex_lock(RumMutex* mutex) { AcquireSRWLockExclusive((PSRWLOCK)&mutex->handle); }
+void _rum_mutex_unlock(RumMutex* mutex) { ReleaseSRWLockExclusive((PSRWLOCK)&mutex->handle); }
+
+void _rum_cond_init(RumCond* cond) { InitializeConditionVariable((PCONDITION_VARIABLE)&cond->handle); }
+void _rum_cond_destroy(RumCond* cond) { (void)cond; }
+void _rum_cond_wait(RumCond* cond, RumMutex* mutex) { SleepConditionVariableSRW((PCONDITION_VARIABLE)&cond->handle, (PSRWLOCK)&mutex->handle, INFINITE, 0); }
+void _rum_cond_broadcast(RumCond* cond) { WakeAllConditionVariable((PCONDITION_VARIABLE)&cond->handle); }
+
+// Older SDKs lack it, older Windows versions then fail to create the timer
+#if !defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+    #define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// Sleep only wakes on the scheduler tick, 15.6 ms unless something raised the timer resolution, which would make
+// the frame limiter overshoot by a whole tick. A high resolution timer (Windows 10 1803 and later) wakes within
+// a fraction of a millisecond without changing the resolution for the whole system
+void _rum_sleep(double seconds) {
+    HANDLE timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if(timer) {
+        // Negative due times are relative, in 100 ns units
+        LARGE_INTEGER due;
+        due.QuadPart = -(LONGLONG)(seconds * 1e7);
+        bool set = SetWaitableTimerEx(timer, &due, 0, NULL, NULL, NULL, 0);
+        if(set)
+            WaitForSingleObject(timer, INFINITE);
+        CloseHandle(timer);
+        if(set)
+            return;
+    }
+    Sleep((DWORD)(seconds * 1000.0));
+}
+
+#else
+
+typedef struct {
+    RumThreadFunc func;
+    void* user;
+} ThreadStart;
+
+static void* thread_start(void* param) {
+    ThreadStart start = *(ThreadStart*)param;
+    free(param);
+    start.func(start.user);
+    return NULL;
+}
+
+bool _rum_thread_create(RumThread* thread, RumThreadFunc func, void* user) {
+    ThreadStart* start = malloc(sizeof(ThreadStart));
+    if(!start)
+        return false;
+    start->func = func;
+    start->user = user;
+    if(pthread_create(&thread->handle, NULL, thread_start, start) != 0) {
+        free(start);
+        return false;
+    }
+    return true;
+}
+
+void _rum_thread_join(RumThread* thread) {
+    pthread_join(thread->handle, NULL);
+}
+
+void _rum_mutex_init(RumMutex* mutex) { pthread_mutex_init(&mutex->handle, NULL); }
+void _rum_mutex_destroy(RumMutex* mutex) { pthread_mutex_destroy(&mutex->handle); }
+void _rum_mutex_lock(RumMutex* mutex) { pthread_mutex_lock(&mutex->handle); }
+void _rum_mutex_unlock(RumMutex* mutex) { pthread_mutex_unlock(&mutex->handle); }
+
+void _rum_cond_init(RumCond* cond) { pthread_cond_init(&cond->handle, NULL); }
+void _rum_cond_destroy(RumCond* cond) { pthread_cond_destroy(&cond->handle); }
+void _rum_cond_wait(RumCond* cond, RumMutex* mutex) { pthread_cond_wait(&cond->handle, &mutex->handle); }
+void _rum_cond_broadcast(RumCond* cond) { pthread_cond_broadcast(&cond->handle); }
+
+void _rum_sleep(double seconds) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)((seconds - (double)ts.tv_sec) * 1e9);
+    while(nanosleep(&ts, &ts) != 0)
+        ;
+}
+
+#endif // _WIN32
+
+struct RumWorkerPool {
+    RumMutex mutex;
+    RumCond wake, idle;
+    RumThread* threads;
+    uint32_t worker_count;
+
+    // A new job is published by bumping the generation, workers that joined it count as busy
+    uint64_t generation;
+    uint32_t busy;
+    bool quit;
+
+    RumJobFunc job;
+    void* user;
+    uint32_t job_count;
+    atomic_uint next_index;
+
+    // Held by the thread whose job the workers are running, others run theirs alone instead of waiting for it
+    atomic_flag running;
+};
+
+static void pool_drain(RumWorkerPool* pool, RumJobFunc job, void* user, uint32_t job_count) {
+    uint32_t index;
+    while((index = atomic_fetch_add(&pool->next_index, 1)) < job_count)
+        job(user, index);
+}
+
+static void pool_worker(void* user) {
+    RumWorkerPool* pool = user;
+    uint64_t seen = 0;
+
+    _rum_mutex_lock(&pool->mutex);
+    for(;;) {
+        while(seen == pool->generation && !pool->quit)
+            _rum_cond_wait(&pool->wake, &pool->mutex);
+        if(pool->quit)
+            break;
+
+        seen = pool->generation;
+        pool->busy++;
+        RumJobFunc job = pool->job;
+        void* job_user = pool->user;
+        uint32_t job_count = pool->job_count;
+        _rum_mutex_unlock(&pool->mutex);
+
+        pool_drain(pool, job, job_user, job_count);
+
+        _rum_mutex_lock(&pool->mutex);
+        if(--pool->busy == 0)
+            _rum_cond_broadcast(&pool->idle);
+    }
+    _rum_mutex_unlock(&pool->mutex);
+}
+
+RumWorkerPool* _rum_pool_create(uint32_t worker_count) {
+    if(worker_count == 0)
+        return NULL;
+
+    RumWorkerPool* pool = calloc(1, sizeof(RumWorkerPool));
+    if(!pool)
+        return NULL;
+    pool->threads = calloc(worker_count, sizeof(RumThread));
+    if(!pool->threads) {
+        free(pool);
+        return NULL;
+    }
+
+    _rum_mutex_init(&pool->mutex);
+    _rum_cond_init(&pool->wake);
+    _rum_cond_init(&pool->idle);
+    atomic_init(&pool->next_index, 0);
+    atomic_flag_clear(&pool->running);
+
+    for(uint32_t i = 0; i < worker_count; ++i) {
+        if(!_rum_thread_create(&pool->threads[i], pool_worker, pool))
+            break;
+        pool->worker_count++;
+    }
+
+    if(pool->worker_count == 0) {
+        _rum_pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void _rum_pool_destroy(RumWorkerPool* pool) {
+    if(!pool)
+        return;
+
+    _rum_mutex_lock(&pool->mutex);
+    pool->quit = true;
+    _rum_cond_broadcast(&pool->wake);
+    _rum_mutex_unlock(&pool->mutex);
+
+    for(uint32_t i = 0; i < pool->worker_count; ++i)
+        _rum_thread_join(&pool->threads[i]);
+
+    _rum_cond_destroy(&pool->idle);
+    _rum_cond_destroy(&pool->wake);
+    _rum_mutex_destroy(&pool->mutex);
+    free(pool->threads);
+    free(pool);
+}
+
+uint32_t _rum_pool_get_worker_count(const RumWorkerPool* pool) {
+    return pool ? pool->worker_count : 0;
+}
+
+void _rum_pool_run(RumWorkerPool* pool, RumJobFunc job, void* user, uint32_t job_count) {
+    if(!pool || job_count <= 1 || atomic_flag_test_and_set_explicit(&pool->running, memory_order_acquire)) {
+        for(uint32_t i = 0; i < job_count; ++i)
+            job(user, i);
+        return;
+    }
+
+    _rum_mutex_lock(&pool->mutex);
+    // A worker that woke up late may still hold the previous job, it must leave before the counter resets
+    while(pool->busy > 0)
+        _rum_cond_wait(&pool->idle, &pool->mutex);
+    pool->job = job;
+    pool->user = user;
+    pool->job_count = job_count;
+    atomic_store(&pool->next_index, 0);
+    pool->generation++;
+    _rum_cond_broadcast(&pool->wake);
+    _rum_mutex_unlock(&pool->mutex);
+
+    pool_drain(pool, job, user, job_count);
+
+    _rum_mutex_lock(&pool->mutex);
+    while(pool->busy > 0)
+        _rum_cond_wait(&pool->idle, &pool->mutex);
+    _rum_mutex_unlock(&pool->mutex);
+    atomic_flag_clear_explicit(&pool->running, memory_order_release);
+}
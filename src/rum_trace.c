@@ -0,0 +1,147 @@
+/**************************************************************************************
+ *
+ *  MIT License
+ *
+ *  Copyright (c) 2023 Bagas J. Sitanggang
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ ************************************************************************************/
+#include "rum_internal.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <stdio.h>
+#include <stdatomic.h>
+
+#include <GLFW/glfw3.h>
+
+#if !defined(RUM_NO_TRACE)
+
+// Events kept in the ring, the oldest are overwritten once it is full. Must be a power of two
+#ifndef RUM_TRACE_CAPACITY
+    #define RUM_TRACE_CAPACITY (64 * 1024)
+#endif
+
+// Fields are relaxed atomics so a dump racing with writers only ever sees torn events, which the sequence rejects
+typedef struct {
+    atomic_uint_fast64_t sequence;
+    _Atomic(const char*) name;
+    atomic_uint_fast64_t timestamp;
+    atomic_uint thread;
+    atomic_char phase;
+} RumTraceEvent;
+
+atomic_bool _rum_tracing = false;
+
+static RumTraceEvent trace_events[RUM_TRACE_CAPACITY];
+static atomic_uint_fast64_t trace_head = 0;
+static atomic_uint trace_thread_count = 0;
+static _Thread_local uint32_t trace_thread = 0;
+
+void _rum_trace_push(const char* name, char phase) {
+    if(trace_thread == 0)
+        trace_thread = atomic_fetch_add(&trace_thread_count, 1) + 1;
+    uint64_t timestamp = glfwGetTimerValue();
+
+    // Claiming the index is the only contended step, after it each writer owns its slot
+    uint64_t index = atomic_fetch_add_explicit(&trace_head, 1, memory_order_relaxed);
+    RumTraceEvent* event = &trace_events[index & (RUM_TRACE_CAPACITY - 1)];
+    atomic_store_explicit(&event->sequence, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&event->name, name, memory_order_relaxed);
+    atomic_store_explicit(&event->timestamp, timestamp, memory_order_relaxed);
+    atomic_store_explicit(&event->thread, trace_thread, memory_order_relaxed);
+    atomic_store_explicit(&event->phase, phase, memory_order_relaxed);
+    atomic_store_explicit(&event->sequence, index + 1, memory_order_release);
+}
+
+void rum_set_trace(bool enabled) {
+    atomic_store(&_rum_tracing, enabled);
+}
+
+void rum_trace_begin(const char* name) {
+    if(atomic_load_explicit(&_rum_tracing, memory_order_relaxed))
+        _rum_trace_push(name, 'B');
+}
+
+void rum_trace_end() {
+    if(atomic_load_explicit(&_rum_tracing, memory_order_relaxed))
+        _rum_trace_push(NULL, 'E');
+}
+
+static void write_json_string(FILE* file, const char* text) {
+    fputc('"', file);
+    for(; *text; ++text) {
+        if(*text == '"' || *text == '\\')
+            fputc('\\', file);
+        if((unsigned char)*text >= 0x20)
+            fputc(*text, file);
+    }
+    fputc('"', file);
+}
+
+bool rum_trace_dump(const char* path) {
+    FILE* file = fopen(path, "wb");
+    if(!file)
+        return false;
+
+    double ticks_per_us = (double)glfwGetTimerFrequency() * 1e-6;
+    if(ticks_per_us <= 0.0)
+        ticks_per_us = 1.0;
+    uint64_t head = atomic_load_explicit(&trace_head, memory_order_acquire);
+    uint64_t first = head > RUM_TRACE_CAPACITY ? head - RUM_TRACE_CAPACITY : 0;
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+    bool separator = false;
+    for(uint64_t index = first; index < head; ++index) {
+        RumTraceEvent* event = &trace_events[index & (RUM_TRACE_CAPACITY - 1)];
+        if(atomic_load_explicit(&event->sequence, memory_order_acquire) != index + 1)
+            continue;
+        const char* name = atomic_load_explicit(&event->name, memory_order_relaxed);
+        uint64_t timestamp = atomic_load_explicit(&event->timestamp, memory_order_relaxed);
+        uint32_t thread = atomic_load_explicit(&event->thread, memory_order_relaxed);
+        char phase = atomic_load_explicit(&event->phase, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        // Overwritten while it was being read
+        if(atomic_load_explicit(&event->sequence, memory_order_relaxed) != index + 1)
+            continue;
+
+        fputs(separator ? ",\n" : "\n", file);
+        separator = true;
+        fprintf(file, "{\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u", phase, (double)timestamp / ticks_per_us, thread);
+        if(name) {
+            fputs(",\"name\":", file);
+            write_json_string(file, name);
+        }
+        fputc('}', file);
+    }
+    fputs("\n]}\n", file);
+    return fclose(file) == 0;
+}
+
+#else
+
+void rum_set_trace(bool enabled) { (void)enabled; }
+void rum_trace_begin(const char* name) { (void)name; }
+void rum_trace_end() {}
+bool rum_trace_dump(const char* path) { (void)path; return false; }
+
+#endif // RUM_NO_TRACE